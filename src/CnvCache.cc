@@ -0,0 +1,373 @@
+/*
+ *      CnvCache.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvCache.hh"
+#include "CnvMappedFile.hh"
+
+#include <glibmm.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* This file defines a binary file format for data sequences that share their
+   data points, so that files do not have to be parsed again every time they
+   are opened. A file holds the manifest once, the names as a string table
+   and the chromosomes and positions as packed columns, followed by one column
+   of floats for every sequence. All columns begin at a multiple of 64 bytes,
+   so the sequences that are loaded borrow their values straight from the
+   mapped file instead of copying them. The header carries a version, the
+   byte order, a hash of the manifest and the names and the size and time of
+   modification, in nanoseconds, of the file the cache was made from.
+
+   load_cached keeps such a cache next to a text file, with ".nfcb" appended
+   to its name, and only parses the text file if the cache is missing, was
+   made from a different version of it or holds another number of columns
+   than the loader returns. */
+
+namespace Cnv {
+
+namespace {
+
+const unsigned binary_version=3;
+const unsigned binary_byte_order=0x01020304;
+const size_t binary_alignment=64;
+
+class Header
+{
+public:
+	char magic[4];
+	unsigned version;
+	unsigned byte_order;
+	unsigned columns;
+	unsigned long long count;
+	unsigned long long name_bytes;
+	unsigned long long source_size;
+	long long source_mtime;
+	unsigned long long hash;
+	unsigned long long reserved;
+};
+
+size_t align(size_t n)
+{
+	return (n+binary_alignment-1)/binary_alignment*binary_alignment;
+}
+
+//	The offsets of the sections of a file, which follow from its header.
+class Layout
+{
+public:
+
+	Layout(const Header& h)
+	{
+		positions=sizeof(Header);
+		names=align(positions+h.count*sizeof(unsigned));
+		chromosomes=align(names+(h.count+1)*sizeof(unsigned long long));
+		columns=align(chromosomes+h.count);
+		text=columns+h.columns*align(h.count*sizeof(float));
+		size=align(text+h.name_bytes);
+	}
+
+	size_t positions, names, chromosomes, columns, text, size;
+};
+
+//	A hash over words of 8 bytes. The sections are padded to a multiple of
+//	the alignment, so the hashed contents always consist of whole words. Only
+//	the manifest and the names are hashed, the columns are not, so that
+//	opening a file does not read the columns before they are used.
+class Hash
+{
+public:
+
+	Hash():h(0x9e3779b97f4a7c15ULL),used(0) {}
+
+	void add(const char* data, size_t n)
+	{
+		for(; used>0&&n>0; --n)
+		{
+			word[used++]=*data++;
+			if(used==8) mix();
+		}
+		for(; n>=8; n-=8, data+=8)
+		{
+			memcpy(word, data, 8);
+			mix();
+		}
+		for(; n>0; --n) word[used++]=*data++;
+	}
+
+	unsigned long long value() const { return h; }
+
+private:
+
+	void mix()
+	{
+		unsigned long long w;
+		memcpy(&w, word, 8);
+		h=(h^w)*0xff51afd7ed558ccdULL;
+		h^=h>>32;
+		used=0;
+	}
+
+	unsigned long long h;
+	char word[8];
+	unsigned used;
+};
+
+//	Writes n bytes and pads them with zeros to the alignment. They are added
+//	to hash unless it is NULL.
+void write_section(std::FILE* file, const void* data, size_t n, Hash* hash)
+{
+	static const char zeros[binary_alignment]={0};
+	std::fwrite(data, 1, n, file);
+	std::fwrite(zeros, 1, align(n)-n, file);
+	if(hash==NULL) return;
+	hash->add((const char*)data, n);
+	hash->add(zeros, align(n)-n);
+}
+
+//	Names per thread below which starting another thread does not pay.
+const unsigned intern_thread_names=1<<16;
+
+//	Interns the names first to last of a string table.
+void intern(const char* text, const unsigned long long* offsets,
+	StringPointer* names, unsigned first, unsigned last, StringPool* pool)
+{
+	for(unsigned i=first; i<last; ++i)
+		names[i]=(*pool)(text+offsets[i], offsets[i+1]-offsets[i]);
+}
+
+//	The manifests of the files loaded so far, by the pool their names were
+//	interned into and the hash of the file. Files with the same hash have the
+//	same manifest, so a file that is opened again, or another file made from
+//	the same chip, gets the manifest that is already in memory and its names
+//	are not interned again. The manifests are not kept alive by this map.
+typedef std::pair<const StringPool*, unsigned long long> ManifestKey;
+std::map<ManifestKey, std::weak_ptr<const Sequence::Manifest> > manifests;
+Glib::Threads::Mutex manifests_mutex;
+
+bool source_stat(const std::string& f, unsigned long long& size,
+	long long& mtime)
+{
+	struct stat info;
+	if(stat(f.c_str(), &info)!=0||!S_ISREG(info.st_mode)) return false;
+	size=info.st_size;
+	mtime=(long long)info.st_mtim.tv_sec*1000000000+info.st_mtim.tv_nsec;
+	return true;
+}
+
+}
+
+//	All sequences have to share the data points of the first one. The file
+//	is written under a temporary name and renamed when it is complete, so
+//	that other processes never map a partial file.
+bool save_binary(const std::vector<Sequence>& s, std::string f,
+	unsigned long long source_size, long long source_mtime)
+{
+	if(s.empty()||s[0].get_names().size()!=s[0].size()) return false;
+	for(unsigned k=1; k<s.size(); ++k)
+		if(s[k].size()!=s[0].size()||s[k].get_names()!=s[0].get_names())
+			return false;
+
+	const std::vector<StringPointer>& names=s[0].get_names();
+	std::vector<unsigned long long> offsets(names.size()+1, 0);
+	for(size_t i=0; i<names.size(); ++i)
+		offsets[i+1]=offsets[i]+names[i].length();
+
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	memcpy(header.magic, "NFCB", 4);
+	header.version=binary_version;
+	header.byte_order=binary_byte_order;
+	header.columns=s.size();
+	header.count=names.size();
+	header.name_bytes=offsets.back();
+	header.source_size=source_size;
+	header.source_mtime=source_mtime;
+
+	std::string temporary=f+".XXXXXX";
+	int fd=mkstemp(&temporary[0]);
+	if(fd<0) return false;
+	std::FILE* file=fdopen(fd, "wb");
+	if(file==NULL) { close(fd); unlink(temporary.c_str()); return false; }
+
+	Hash hash;
+	std::fwrite(&header, sizeof(Header), 1, file);
+	write_section(file, s[0].get_positions().data(),
+		names.size()*sizeof(unsigned), &hash);
+	write_section(file, offsets.data(),
+		offsets.size()*sizeof(unsigned long long), &hash);
+	write_section(file, s[0].get_chromosomes().data(), names.size(), &hash);
+	for(unsigned k=0; k<s.size(); ++k)
+		write_section(file, s[k].get_values().data(),
+			s[k].size()*sizeof(float), NULL);
+
+	std::vector<char> text;
+	text.reserve(offsets.back());
+	for(size_t i=0; i<names.size(); ++i)
+		text.insert(text.end(), names[i].c_str(),
+			names[i].c_str()+names[i].length());
+	write_section(file, text.data(), text.size(), &hash);
+
+	header.hash=hash.value();
+	std::fseek(file, 0, SEEK_SET);
+	std::fwrite(&header, sizeof(Header), 1, file);
+
+	bool good=!std::ferror(file);
+	good=(std::fclose(file)==0)&&good;
+	if(good) chmod(temporary.c_str(), 0644);
+	if(!good||std::rename(temporary.c_str(), f.c_str())!=0)
+	{
+		unlink(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+namespace {
+
+//	The names are interned into pool on one thread per processor. The
+//	columns are not copied, the sequences borrow them from the mapped file,
+//	which stays mapped as long as one of them does.
+std::vector<Sequence> load_mapped(const std::shared_ptr<MappedFile>& file,
+	StringPool& pool)
+{
+	const char* data=file->data();
+
+	Header header;
+	if(file->size()<sizeof(Header)) return std::vector<Sequence>();
+	memcpy(&header, data, sizeof(Header));
+	if(memcmp(header.magic, "NFCB", 4)!=0||header.version!=binary_version
+		||header.byte_order!=binary_byte_order
+		||header.count>=(1ULL<<32)||header.name_bytes>file->size()
+		||header.columns>file->size())
+		return std::vector<Sequence>();
+
+	Layout layout(header);
+	if(layout.size!=file->size()) return std::vector<Sequence>();
+
+	unsigned n=header.count;
+	ManifestKey key(&pool, header.hash);
+	Sequence::ManifestPointer manifest;
+	{
+		Glib::Threads::Mutex::Lock lock(manifests_mutex);
+		manifest=manifests[key].lock();
+	}
+
+	if(!manifest||manifest->names.size()!=n)
+	{
+		Hash hash;
+		hash.add(data+layout.positions, layout.columns-layout.positions);
+		hash.add(data+layout.text, layout.size-layout.text);
+		if(hash.value()!=header.hash) return std::vector<Sequence>();
+
+		const unsigned long long* offsets=
+			(const unsigned long long*)(data+layout.names);
+		const char* text=data+layout.text;
+
+		for(unsigned i=0; i<n; ++i)
+			if(offsets[i]>offsets[i+1]||offsets[i+1]>header.name_bytes)
+				return std::vector<Sequence>();
+
+		std::shared_ptr<Sequence::Manifest> m(new Sequence::Manifest);
+		m->names.resize(n);
+
+		unsigned threads=std::min(Glib::get_num_processors(),
+			n/intern_thread_names);
+		threads=std::max(1u, threads);
+
+		std::vector<Glib::Threads::Thread*> workers;
+		for(unsigned t=1; t<threads; ++t)
+			workers.push_back(Glib::Threads::Thread::create(sigc::bind(
+				sigc::ptr_fun(intern), text, offsets, &m->names[0],
+				(unsigned)((unsigned long long)n*t/threads),
+				(unsigned)((unsigned long long)n*(t+1)/threads), &pool)));
+		if(n>0) intern(text, offsets, &m->names[0], 0,
+			(unsigned)((unsigned long long)n/threads), &pool);
+		for(unsigned t=0; t<workers.size(); ++t)
+			workers[t]->join();
+
+		m->chromosomes.assign(data+layout.chromosomes,
+			data+layout.chromosomes+n);
+		m->positions.assign((const unsigned*)(data+layout.positions),
+			(const unsigned*)(data+layout.positions)+n);
+		manifest=m;
+
+		Glib::Threads::Mutex::Lock lock(manifests_mutex);
+		manifests[key]=manifest;
+	}
+
+	std::vector<Sequence> out;
+	for(unsigned k=0; k<header.columns; ++k)
+	{
+		const float* column=(const float*)(data+layout.columns
+			+k*align(n*sizeof(float)));
+		out.push_back(Sequence(manifest, column, file));
+	}
+	return out;
+}
+
+}
+
+std::vector<Sequence> load_binary(std::string f, StringPool& pool)
+{
+	std::shared_ptr<MappedFile> file(new MappedFile(f));
+	return load_mapped(file, pool);
+}
+
+//	A cache that cannot be written, for instance in a read only folder, is
+//	silently skipped. Files that load empty are not cached. columns is the
+//	number of sequences that load returns, so that a cache made by another
+//	loader for the same file is not mistaken for one of its own.
+std::vector<Sequence> load_cached(std::string f, StringPool& pool,
+	std::vector<Sequence> (*load)(std::string, StringPool&),
+	unsigned columns)
+{
+	unsigned long long size;
+	long long mtime;
+	if(!source_stat(f, size, mtime)) return load(f, pool);
+
+	std::string cache=f+".nfcb";
+	{
+		std::shared_ptr<MappedFile> file(new MappedFile(cache));
+		Header header;
+		if(file->size()>=sizeof(Header))
+		{
+			memcpy(&header, file->data(), sizeof(Header));
+			if(header.source_size==size&&header.source_mtime==mtime
+				&&header.columns==columns)
+			{
+				std::vector<Sequence> out=load_mapped(file, pool);
+				if(out.size()==columns) return out;
+			}
+		}
+	}
+
+	std::vector<Sequence> out=load(f, pool);
+	if(out.size()==columns&&out[0].size()>0)
+		save_binary(out, cache, size, mtime);
+	return out;
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+ *      CnvCache.hh - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CNVCACHE_
+#define _CNVCACHE_
+#include "CnvSequence.hh"
+#include "CnvStringPool.hh"
+
+#include <string>
+#include <vector>
+
+/* This file defines a binary file format for data sequences that share their
+   data points, so that files do not have to be parsed again every time they
+   are opened. A file holds the manifest once, the names as a string table
+   and the chromosomes and positions as packed columns, followed by one column
+   of floats for every sequence. All columns begin at a multiple of 64 bytes,
+   so the sequences that are loaded borrow their values straight from the
+   mapped file instead of copying them. The header carries a version, the
+   byte order, a hash of the manifest and the names and the size and time of
+   modification, in nanoseconds, of the file the cache was made from.
+
+   load_cached keeps such a cache next to a text file, with ".nfcb" appended
+   to its name, and only parses the text file if the cache is missing, was
+   made from a different version of it or holds another number of columns
+   than the loader returns. */
+
+namespace Cnv {
+
+bool save_binary(const std::vector<Sequence>& s, std::string f,
+	unsigned long long source_size=0, long long source_mtime=0);
+
+std::vector<Sequence> load_binary(std::string f, StringPool& pool);
+
+std::vector<Sequence> load_cached(std::string f, StringPool& pool,
+	std::vector<Sequence> (*load)(std::string, StringPool&),
+	unsigned columns);
+
+}
+
+#endif
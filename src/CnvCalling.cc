@@ -251,7 +251,8 @@ std::vector<double> first_pass(const std::vector<float>& points,
 void calling(const Sequence& seq, bool dupli_delet,
 	std::vector<ReportEntry>& report, const Configuration& config)
 {
-	const std::vector<float>& points=seq.get_values();
+	const Sequence::Values values=seq.get_values();
+	const std::vector<float> points(values.begin(), values.end());
 	std::vector<double> deviation=analyze_noise(points, config);
 	std::vector<double> grid=first_pass(points, dupli_delet, config);
 
@@ -370,21 +371,24 @@ void calling(const Sequence& seq, bool dupli_delet,
 
 		if((1.0-best_left_score)*(1.0-best_right_score)>=config.final_threshold)
 		{
+			unsigned start_number=best_start-points.begin();
+			unsigned end_number=best_end-points.begin()-1;
+
 			std::string id1, id2, chr1, chr2, pos1, pos2;
-			decompose_point_name(seq.get_names()[best_start-points.begin()], id1, chr1, pos1);
-			decompose_point_name(seq.get_names()[best_end-points.begin()-1], id2, chr2, pos2);
+			decompose_point_name(seq.get_names()[start_number], id1, chr1, pos1);
+			decompose_point_name(seq.get_names()[end_number], id2, chr2, pos2);
 
 			ReportEntry entry;
 			if(dupli_delet) entry.type=3;
 			else entry.type=1;
 
-			entry.start_number=best_start-points.begin();
-			entry.end_number=best_end-points.begin()-1;
-			entry.chromosome=decode_chr(chr1.begin(), chr1.end());
+			entry.start_number=start_number;
+			entry.end_number=end_number;
+			entry.chromosome=seq.chromosome(start_number);
 			entry.start_id=id1;
 			entry.end_id=id2;
-			entry.start_pos=decode_pos(pos1.begin(), pos1.end());
-			entry.end_pos=decode_pos(pos2.begin(), pos2.end());
+			entry.start_pos=seq.position(start_number);
+			entry.end_pos=seq.position(end_number);
 			entry.score_inner=(1.0-best_left_score)*(1.0-best_right_score);
 			entry.score_enter=1.0-best_left_score;
 			entry.score_leave=1.0-best_right_score;
@@ -21,14 +21,20 @@
 #include <string>
 #include <cmath>
 #include <climits>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <locale.h>
 
 /* This file is used for encoding data into character strings and to decode
    character strings of that kind. */
 
 namespace Cnv {
 
-unsigned char decode_chr(std::string::const_iterator i,
-	std::string::const_iterator end)
+namespace {
+
+template<class I> unsigned char parse_chr(I i, I end)
 {
 	if(end-i==1&&i[0]>='0'&&i[0]<='9')
 		return (unsigned char)(i[0]-'0');
@@ -49,6 +55,278 @@ unsigned char decode_chr(std::string::const_iterator i,
 	else return UCHAR_MAX;
 }
 
+template<class I> unsigned parse_pos(I i, I end)
+{
+	unsigned result=0;
+	while(i!=end&&*i>='0'&&*i<='9')
+		result=result*10+(unsigned)(*(i++)-'0');
+
+	if(i==end) return result;
+	else return 0;
+}
+
+//	The powers of five from 5^-65 to 5^38, normalized to 128 bits, the high
+//	half first. Smaller and larger powers of ten only yield zero or infinity
+//	as floats.
+const int smallest_power_of_ten=-65;
+const int largest_power_of_ten=38;
+const unsigned long long power_of_five[][2]={
+	{0x86ccbb52ea94baea, 0x98e947129fc2b4e9}, {0xa87fea27a539e9a5, 0x3f2398d747b36224},
+	{0xd29fe4b18e88640e, 0x8eec7f0d19a03aad}, {0x83a3eeeef9153e89, 0x1953cf68300424ac},
+	{0xa48ceaaab75a8e2b, 0x5fa8c3423c052dd7}, {0xcdb02555653131b6, 0x3792f412cb06794d},
+	{0x808e17555f3ebf11, 0xe2bbd88bbee40bd0}, {0xa0b19d2ab70e6ed6, 0x5b6aceaeae9d0ec4},
+	{0xc8de047564d20a8b, 0xf245825a5a445275}, {0xfb158592be068d2e, 0xeed6e2f0f0d56712},
+	{0x9ced737bb6c4183d, 0x55464dd69685606b}, {0xc428d05aa4751e4c, 0xaa97e14c3c26b886},
+	{0xf53304714d9265df, 0xd53dd99f4b3066a8}, {0x993fe2c6d07b7fab, 0xe546a8038efe4029},
+	{0xbf8fdb78849a5f96, 0xde98520472bdd033}, {0xef73d256a5c0f77c, 0x963e66858f6d4440},
+	{0x95a8637627989aad, 0xdde7001379a44aa8}, {0xbb127c53b17ec159, 0x5560c018580d5d52},
+	{0xe9d71b689dde71af, 0xaab8f01e6e10b4a6}, {0x9226712162ab070d, 0xcab3961304ca70e8},
+	{0xb6b00d69bb55c8d1, 0x3d607b97c5fd0d22}, {0xe45c10c42a2b3b05, 0x8cb89a7db77c506a},
+	{0x8eb98a7a9a5b04e3, 0x77f3608e92adb242}, {0xb267ed1940f1c61c, 0x55f038b237591ed3},
+	{0xdf01e85f912e37a3, 0x6b6c46dec52f6688}, {0x8b61313bbabce2c6, 0x2323ac4b3b3da015},
+	{0xae397d8aa96c1b77, 0xabec975e0a0d081a}, {0xd9c7dced53c72255, 0x96e7bd358c904a21},
+	{0x881cea14545c7575, 0x7e50d64177da2e54}, {0xaa242499697392d2, 0xdde50bd1d5d0b9e9},
+	{0xd4ad2dbfc3d07787, 0x955e4ec64b44e864}, {0x84ec3c97da624ab4, 0xbd5af13bef0b113e},
+	{0xa6274bbdd0fadd61, 0xecb1ad8aeacdd58e}, {0xcfb11ead453994ba, 0x67de18eda5814af2},
+	{0x81ceb32c4b43fcf4, 0x80eacf948770ced7}, {0xa2425ff75e14fc31, 0xa1258379a94d028d},
+	{0xcad2f7f5359a3b3e, 0x096ee45813a04330}, {0xfd87b5f28300ca0d, 0x8bca9d6e188853fc},
+	{0x9e74d1b791e07e48, 0x775ea264cf55347e}, {0xc612062576589dda, 0x95364afe032a819e},
+	{0xf79687aed3eec551, 0x3a83ddbd83f52205}, {0x9abe14cd44753b52, 0xc4926a9672793543},
+	{0xc16d9a0095928a27, 0x75b7053c0f178294}, {0xf1c90080baf72cb1, 0x5324c68b12dd6339},
+	{0x971da05074da7bee, 0xd3f6fc16ebca5e04}, {0xbce5086492111aea, 0x88f4bb1ca6bcf585},
+	{0xec1e4a7db69561a5, 0x2b31e9e3d06c32e6}, {0x9392ee8e921d5d07, 0x3aff322e62439fd0},
+	{0xb877aa3236a4b449, 0x09befeb9fad487c3}, {0xe69594bec44de15b, 0x4c2ebe687989a9b4},
+	{0x901d7cf73ab0acd9, 0x0f9d37014bf60a11}, {0xb424dc35095cd80f, 0x538484c19ef38c95},
+	{0xe12e13424bb40e13, 0x2865a5f206b06fba}, {0x8cbccc096f5088cb, 0xf93f87b7442e45d4},
+	{0xafebff0bcb24aafe, 0xf78f69a51539d749}, {0xdbe6fecebdedd5be, 0xb573440e5a884d1c},
+	{0x89705f4136b4a597, 0x31680a88f8953031}, {0xabcc77118461cefc, 0xfdc20d2b36ba7c3e},
+	{0xd6bf94d5e57a42bc, 0x3d32907604691b4d}, {0x8637bd05af6c69b5, 0xa63f9a49c2c1b110},
+	{0xa7c5ac471b478423, 0x0fcf80dc33721d54}, {0xd1b71758e219652b, 0xd3c36113404ea4a9},
+	{0x83126e978d4fdf3b, 0x645a1cac083126ea}, {0xa3d70a3d70a3d70a, 0x3d70a3d70a3d70a4},
+	{0xcccccccccccccccc, 0xcccccccccccccccd}, {0x8000000000000000, 0x0000000000000000},
+	{0xa000000000000000, 0x0000000000000000}, {0xc800000000000000, 0x0000000000000000},
+	{0xfa00000000000000, 0x0000000000000000}, {0x9c40000000000000, 0x0000000000000000},
+	{0xc350000000000000, 0x0000000000000000}, {0xf424000000000000, 0x0000000000000000},
+	{0x9896800000000000, 0x0000000000000000}, {0xbebc200000000000, 0x0000000000000000},
+	{0xee6b280000000000, 0x0000000000000000}, {0x9502f90000000000, 0x0000000000000000},
+	{0xba43b74000000000, 0x0000000000000000}, {0xe8d4a51000000000, 0x0000000000000000},
+	{0x9184e72a00000000, 0x0000000000000000}, {0xb5e620f480000000, 0x0000000000000000},
+	{0xe35fa931a0000000, 0x0000000000000000}, {0x8e1bc9bf04000000, 0x0000000000000000},
+	{0xb1a2bc2ec5000000, 0x0000000000000000}, {0xde0b6b3a76400000, 0x0000000000000000},
+	{0x8ac7230489e80000, 0x0000000000000000}, {0xad78ebc5ac620000, 0x0000000000000000},
+	{0xd8d726b7177a8000, 0x0000000000000000}, {0x878678326eac9000, 0x0000000000000000},
+	{0xa968163f0a57b400, 0x0000000000000000}, {0xd3c21bcecceda100, 0x0000000000000000},
+	{0x84595161401484a0, 0x0000000000000000}, {0xa56fa5b99019a5c8, 0x0000000000000000},
+	{0xcecb8f27f4200f3a, 0x0000000000000000}, {0x813f3978f8940984, 0x4000000000000000},
+	{0xa18f07d736b90be5, 0x5000000000000000}, {0xc9f2c9cd04674ede, 0xa400000000000000},
+	{0xfc6f7c4045812296, 0x4d00000000000000}, {0x9dc5ada82b70b59d, 0xf020000000000000},
+	{0xc5371912364ce305, 0x6c28000000000000}, {0xf684df56c3e01bc6, 0xc732000000000000},
+	{0x9a130b963a6c115c, 0x3c7f400000000000}, {0xc097ce7bc90715b3, 0x4b9f100000000000},
+	{0xf0bdc21abb48db20, 0x1e86d40000000000}, {0x96769950b50d88f4, 0x1314448000000000}
+};
+
+const float exact_power_of_ten[]={1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f,
+	1e7f, 1e8f, 1e9f, 1e10f};
+
+//	Computes the bits of the float nearest to w*10^q with the algorithm of
+//	Eisel and Lemire, as in "Number Parsing at a Gigabyte per Second". Ties
+//	are rounded to even.
+unsigned eisel_lemire(unsigned long long w, int q)
+{
+	if(w==0||q<smallest_power_of_ten) return 0;
+	if(q>largest_power_of_ten) return 0xFFu<<23;
+
+	int zeros=__builtin_clzll(w);
+	w<<=zeros;
+
+	//	The upper bits of w*5^q, refined by the lower half of the power if
+	//	they are not enough to decide the rounding.
+	const unsigned long long* power=power_of_five[q-smallest_power_of_ten];
+	unsigned __int128 product=(unsigned __int128)w*power[0];
+	unsigned long long high=product>>64, low=product;
+	const unsigned long long mask=~0ULL>>26;
+	if((high&mask)==mask)
+	{
+		unsigned long long second=((unsigned __int128)w*power[1])>>64;
+		low+=second;
+		if(second>low) high++;
+	}
+
+	int upper=high>>63;
+	int shift=upper+64-23-3;
+	unsigned long long mantissa=high>>shift;
+	int exponent=(((152170+65536)*q)>>16)+63+upper-zeros+127;
+
+	if(exponent<=0)
+	{
+		if(-exponent+1>=64) return 0;
+		mantissa>>=-exponent+1;
+		mantissa+=mantissa&1;
+		mantissa>>=1;
+		return mantissa;
+	}
+
+	//	Exactly halfway between two floats, which only happens for small q.
+	if(low<=1&&q>=-17&&q<=10&&(mantissa&3)==1&&(mantissa<<shift)==high)
+		mantissa&=~1ULL;
+
+	mantissa+=mantissa&1;
+	mantissa>>=1;
+	if(mantissa>=(2ULL<<23))
+	{
+		mantissa=1ULL<<23;
+		exponent++;
+	}
+	if(exponent>=0xFF) return 0xFFu<<23;
+	return (mantissa&~(1ULL<<23))|((unsigned long long)exponent<<23);
+}
+
+//	Compares a word case insensitively with the characters from i to end.
+template<class I> bool equal_word(I i, I end, const char* word)
+{
+	for(; i!=end&&*word; ++i, ++word)
+		if((*i|0x20)!=*word) return false;
+	return i==end&&*word==0;
+}
+
+//	Keeps the first 19 significant digits of a long number in w and only
+//	notes whether any of the others is not zero.
+template<class I> unsigned long long significant_digits(I i, I end, int& q,
+	bool& truncated)
+{
+	unsigned long long w=0;
+	int digits=0;
+	q=0;
+	for(; i!=end&&*i>='0'&&*i<='9'; ++i)
+	{
+		if(digits<19) { w=w*10+(*i-'0'); digits+=(w>0); }
+		else { truncated|=*i!='0'; q++; }
+	}
+	if(i!=end) ++i;
+	for(; i!=end; ++i)
+	{
+		if(digits<19) { w=w*10+(*i-'0'); digits+=(w>0); q--; }
+		else truncated|=*i!='0';
+	}
+	return w;
+}
+
+//	Parses any number that the fast path of parse_float_value leaves over.
+//	It is kept out of line, so that the fast path stays small.
+template<class I> __attribute__((noinline)) float parse_any_float(I i, I end)
+{
+	while(i!=end&&(*i==' '||*i=='\t'||*i=='\r'||*i=='\n')) ++i;
+	while(i!=end&&(end[-1]==' '||end[-1]=='\t'||end[-1]=='\r'||end[-1]=='\n'))
+		--end;
+	I first=i;
+
+	bool negative=false;
+	if(i!=end&&(*i=='+'||*i=='-')) negative=*(i++)=='-';
+	if(i==end) return negative?-0.0f:0.0f;
+
+	//	The digits are collected in w, q is the power of ten that w is
+	//	multiplied with. Longer numbers than w can hold are read again.
+	I start=i;
+	unsigned long long w=0;
+	for(; i!=end&&(unsigned)(*i-'0')<10; ++i) w=w*10+(*i-'0');
+	int count=i-start, q=0;
+	if(i!=end&&(*i=='.'||*i==','))
+	{
+		I fraction=++i;
+		for(; i!=end&&(unsigned)(*i-'0')<10; ++i) w=w*10+(*i-'0');
+		q=fraction-i;
+		count+=i-fraction;
+	}
+	bool any=count>0, truncated=false;
+	if(count>19) w=significant_digits(start, i, q, truncated);
+
+	if(!any)
+	{
+		float special=0.0/0.0;
+		if(equal_word(i, end, "inf")||equal_word(i, end, "infinity"))
+			special=HUGE_VALF;
+		else if(!equal_word(i, end, "nan")) return 0.0/0.0;
+		return negative?-special:special;
+	}
+
+	if(i!=end&&(*i=='e'||*i=='E'))
+	{
+		bool negative_exponent=false;
+		if(++i!=end&&(*i=='+'||*i=='-')) negative_exponent=*(i++)=='-';
+		if(i==end) return 0.0/0.0;
+
+		int e=0;
+		for(; i!=end&&*i>='0'&&*i<='9'; ++i)
+			if(e<100000) e=e*10+(*i-'0');
+		q+=negative_exponent?-e:e;
+	}
+	if(i!=end) return 0.0/0.0;
+
+	float out;
+	if(!truncated&&w<=(1ULL<<24)&&q>=-10&&q<=10)
+	{
+		//	Both operands are exact, so the one rounding is correct.
+		out=q<0?(float)w/exact_power_of_ten[-q]:(float)w*exact_power_of_ten[q];
+		return negative?-out:out;
+	}
+
+	unsigned bits=eisel_lemire(w, q);
+	if(truncated&&bits!=eisel_lemire(w+1, q))
+	{
+		//	The digits that were left out decide the rounding, which is left
+		//	to the C library.
+		static locale_t c_locale=newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+		std::string text(first, end);
+		std::replace(text.begin(), text.end(), ',', '.');
+		return strtof_l(text.c_str(), NULL, c_locale);
+	}
+	bits|=(unsigned)negative<<31;
+	memcpy(&out, &bits, sizeof(out));
+	return out;
+}
+
+//	Parses a decimal number into the nearest float, like strtof does in the
+//	C locale. A comma works as decimal point, "NaN", "Inf" and "Infinity"
+//	are understood in any case and whitespace around the number is skipped.
+//	An empty field is zero and anything else that is not a number is NaN.
+template<class I> float parse_float_value(I i, I end)
+{
+	//	Short plain numbers, the rule in the data files, are converted right
+	//	here with a single rounding.
+	I first=i;
+	float sign=1.0f;
+	if(i!=end&&*i=='-') { sign=-1.0f; ++i; }
+
+	I start=i;
+	unsigned long long w=0;
+	for(; i!=end&&(unsigned)(*i-'0')<10; ++i) w=w*10+(*i-'0');
+	int count=i-start, q=0;
+	if(i!=end&&(*i=='.'||*i==','))
+	{
+		I fraction=++i;
+		for(; i!=end&&(unsigned)(*i-'0')<10; ++i) w=w*10+(*i-'0');
+		q=fraction-i;
+		count+=i-fraction;
+	}
+
+	if(i==end&&count>0&&count<=19&&w<=(1ULL<<24)&&q>=-10)
+		return sign*((float)w/exact_power_of_ten[-q]);
+	return parse_any_float(first, end);
+}
+
+}
+
+unsigned char decode_chr(std::string::const_iterator i,
+	std::string::const_iterator end)
+{
+	return parse_chr(i, end);
+}
+
+unsigned char decode_chr(const char* i, const char* end)
+{
+	return parse_chr(i, end);
+}
+
 unsigned char decode_chr(const std::string& s)
 {
 	return decode_chr(s.begin(), s.end());
@@ -74,12 +352,12 @@ std::string encode_chr(unsigned char c)
 unsigned decode_pos(std::string::const_iterator i,
 	std::string::const_iterator end)
 {
-	unsigned result=0;
-	while(i!=end&&*i>='0'&&*i<='9')
-		result=result*10+(unsigned)(*(i++)-'0');
+	return parse_pos(i, end);
+}
 
-	if(i==end) return result;
-	else return 0;
+unsigned decode_pos(const char* i, const char* end)
+{
+	return parse_pos(i, end);
 }
 
 unsigned decode_pos(const std::string& s)
@@ -89,61 +367,28 @@ unsigned decode_pos(const std::string& s)
 
 std::string encode_pos(unsigned p)
 {
-	std::string out;
-	unsigned factor=1;
-	while(p/factor>=10) factor*=10;
-	for(; factor>0; factor/=10)
-	{
-		out.push_back('0'+p/factor);
-		p=p%factor;
-	}
+	char out[10];
+	return std::string(out, format_pos(p, out));
+}
+
+char* format_pos(unsigned p, char* out)
+{
+	char digits[10];
+	unsigned n=0;
+	do { digits[n++]='0'+p%10; p/=10; } while(p>0);
+	while(n>0) *(out++)=digits[--n];
 	return out;
 }
 
 float decode_float_value(std::string::const_iterator i,
 	std::string::const_iterator end)
 {
-	float sign=1.0;
-	if(i!=end&&*i=='+') ++i;
-	else if(i!=end&&*i=='-') { sign=-1.0; ++i; }
-
-	float first_number=0.0;
-	while(i!=end&&*i>='0'&&*i<='9')
-		first_number=first_number*10.0+(float)(*(i++)-'0');
+	return parse_float_value(i, end);
+}
 
-	if(i==end) return sign*first_number;
-	else if(*i=='.'||*i==',')
-	{
-		--end;
-		float last_number=0.0;
-		std::string::const_reverse_iterator jt;
-		while(*end>='0'&&*end<='9')
-			last_number=(last_number+(float)(*(end--)-'0'))/10.0;
-
-		if(i==end)
-			return sign*(first_number+last_number);
-		else
-		{
-			float exp_base=10.0;
-			if(*end=='+') --end;
-			else if(*end=='-') { sign=0.1; --end; }
-
-			if(*end=='e'||*end=='E')
-			{
-				--end;
-				float middle_number=0.0;
-				std::string::const_reverse_iterator jt;
-				while(*end>='0'&&*end<='9')
-					middle_number=(middle_number+(float)(*(end--)-'0'))/10.0;
-
-				if(i==end)
-					return sign*(first_number+middle_number)*pow(exp_base, last_number);
-				else return 0.0/0.0;
-			}
-			else return 0.0/0.0;
-		}
-	}
-	else return 0.0/0.0;
+float decode_float_value(const char* i, const char* end)
+{
+	return parse_float_value(i, end);
 }
 
 float decode_float_value(const std::string s)
@@ -153,29 +398,43 @@ float decode_float_value(const std::string s)
 
 std::string encode_float_value(float v)
 {
-	if(std::isnan(v)||std::isinf(v)) return "NaN";
-	else
+	char out[float_value_chars];
+	return std::string(out, format_float_value(v, out));
+}
+
+//	Values are rounded to four decimals in integer arithmetic, trailing zeros
+//	are left out. The product of a float and 10000 is exact in a double.
+char* format_float_value(float v, char* out)
+{
+	if(std::isnan(v)||std::isinf(v))
 	{
-		std::string out;
-		if(v<0.0) out.push_back('-');
-		v=fabs(v)+0.00005;
+		memcpy(out, "NaN", 3);
+		return out+3;
+	}
+	if(v<0.0) *(out++)='-';
 
-		float factor=1.0;
-		while(v/factor>=10.0) factor*=10.0;
-		for(; factor>0.5; factor/=10.0)
-		{
-			out.push_back('0'+(char)(v/factor));
-			v-=(float)(unsigned)(v/factor)*factor;
-		}
-		if(v>0.0001) out.push_back('.');
+	double a=fabs((double)v);
+	if(a>=1e15) return out+sprintf(out, "%.0f", a);
+
+	unsigned long long scaled=(unsigned long long)(a*10000.0+0.5);
+	unsigned long long whole=scaled/10000;
+	unsigned fraction=scaled%10000;
 
-		for(; v>0.0001; factor/=10.0)
+	char digits[20];
+	unsigned n=0;
+	do { digits[n++]='0'+whole%10; whole/=10; } while(whole>0);
+	while(n>0) *(out++)=digits[--n];
+
+	if(fraction>0)
+	{
+		*(out++)='.';
+		for(unsigned factor=1000; fraction>0; factor/=10)
 		{
-			out.push_back('0'+(char)(v/factor));
-			v-=(float)(unsigned)(v/factor)*factor;
+			*(out++)='0'+fraction/factor;
+			fraction%=factor;
 		}
-		return out;
 	}
+	return out;
 }
 
 std::string compose_point_name(const std::string& id,
@@ -236,4 +495,24 @@ void decompose_point_name(const std::string& n, std::string& id,
 		pos=decode_pos(n.begin()+found_start, n.end());
 }
 
+//	Like decompose_point_name, without copying the identifier.
+void decompose_point_name(const char* n, const char* end,
+	unsigned char& chr, unsigned& pos)
+{
+	const char* found_start=(const char*)memchr(n, '/', end-n);
+	if(found_start!=NULL) found_start+=1;
+	else found_start=end;
+
+	const char* found_end=(const char*)memchr(found_start, '/', end-found_start);
+	if(found_end!=NULL)
+	{
+		chr=decode_chr(found_start, found_end);
+		found_start=found_end+1;
+	}
+	else found_start=end;
+
+	if(found_start<end)
+		pos=decode_pos(found_start, end);
+}
+
 }
@@ -29,6 +29,8 @@ namespace Cnv {
 unsigned char decode_chr(std::string::const_iterator i,
 	std::string::const_iterator end);
 
+unsigned char decode_chr(const char* i, const char* end);
+
 unsigned char decode_chr(const std::string& s);
 
 std::string encode_chr(unsigned char c);
@@ -36,17 +38,29 @@ std::string encode_chr(unsigned char c);
 unsigned decode_pos(std::string::const_iterator i,
 	std::string::const_iterator end);
 
+unsigned decode_pos(const char* i, const char* end);
+
 unsigned decode_pos(const std::string& s);
 
 std::string encode_pos(unsigned p);
 
+//	Writes p to out and returns the end of it, at most 10 characters.
+char* format_pos(unsigned p, char* out);
+
 float decode_float_value(std::string::const_iterator i,
 	std::string::const_iterator end);
 
+float decode_float_value(const char* i, const char* end);
+
 float decode_float_value(const std::string s);
 
 std::string encode_float_value(float v);
 
+//	Writes v like encode_float_value to out and returns the end of it, at
+//	most float_value_chars characters.
+const unsigned float_value_chars=48;
+char* format_float_value(float v, char* out);
+
 std::string compose_point_name(const std::string& id,
 	const std::string& c, const std::string& p);
 
@@ -59,5 +73,8 @@ void decompose_point_name(const std::string& n, std::string& id,
 void decompose_point_name(const std::string& n, std::string& id,
 	unsigned char& chr, unsigned& pos);
 
+void decompose_point_name(const char* n, const char* end,
+	unsigned char& chr, unsigned& pos);
+
 }
 #endif
@@ -0,0 +1,194 @@
+/*
+ *      CnvExpression.hh - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CNVEXPRESSION_
+#define _CNVEXPRESSION_
+#include "CnvOperations.hh"
+
+/* This file defines deferred arithmetic on data sequences. Arithmetic on a
+   sequence wrapped by Cnv::lazy only records the expression tree. The whole
+   tree is evaluated in a single loop once it is converted to a Sequence,
+   instead of materializing every intermediate result like the operators in
+   CnvOperations.hh do. The results are exactly those of the eager operators.
+   Expressions only refer to their sequences, so they have to be evaluated
+   within the statement that builds them. */
+
+namespace Cnv { namespace Lazy {
+
+//	The base of all expression nodes. E is the type of the derived node, it
+//	provides the value at a given index, the sequences it refers to and an
+//	eager evaluation that is used when the sequences do not share the same
+//	data points.
+template<class E> class Expression
+{
+public:
+
+	const E& self() const { return static_cast<const E&>(*this); }
+
+	Sequence evaluate(AlignmentPlan& p) const;
+	operator Sequence() const { AlignmentPlan p; return evaluate(p); }
+};
+
+class Term : public Expression<Term>
+{
+public:
+
+	explicit Term(const Sequence& s):seq(&s) {}
+
+	float at(unsigned i) const { return seq->get_values()[i]; }
+	void collect(std::vector<const Sequence*>& s) const { s.push_back(seq); }
+	const Sequence& eager() const { return *seq; }
+
+private:
+
+	const Sequence* seq;
+};
+
+class Constant : public Expression<Constant>
+{
+public:
+
+	explicit Constant(float v):value(v) {}
+
+	float at(unsigned) const { return value; }
+	void collect(std::vector<const Sequence*>&) const {}
+	float eager() const { return value; }
+
+private:
+
+	float value;
+};
+
+//	Binary nodes combine their operands like the corresponding functions in
+//	CnvOperations.hh, so that the fused loop yields the same floats.
+struct AddOp
+{
+	static float apply(float a, float b) { return a+b; }
+	template<class L, class R> static Sequence eager(const L& a, const R& b)
+		{ return add(a, b); }
+	static Sequence eager(float a, const Sequence& b) { return add(b, a); }
+};
+
+struct SubOp
+{
+	static float apply(float a, float b) { return a-b; }
+	template<class L, class R> static Sequence eager(const L& a, const R& b)
+		{ return sub(a, b); }
+};
+
+struct MulOp
+{
+	static float apply(float a, float b) { return a*b; }
+	template<class L, class R> static Sequence eager(const L& a, const R& b)
+		{ return mul(a, b); }
+	static Sequence eager(float a, const Sequence& b) { return mul(b, a); }
+};
+
+struct DivOp
+{
+	static float apply(float a, float b) { return a/b; }
+	template<class L, class R> static Sequence eager(const L& a, const R& b)
+		{ return div(a, b); }
+};
+
+template<class Op, class L, class R> class Binary
+	: public Expression<Binary<Op,L,R> >
+{
+public:
+
+	Binary(const L& a, const R& b):left(a),right(b) {}
+
+	float at(unsigned i) const
+		{ return Op::apply(left.at(i), right.at(i)); }
+	void collect(std::vector<const Sequence*>& s) const
+		{ left.collect(s); right.collect(s); }
+	Sequence eager() const
+		{ return Op::eager(left.eager(), right.eager()); }
+
+private:
+
+	L left;
+	R right;
+};
+
+//	Evaluates the expression in a single loop if all its sequences are
+//	aligned by position, and falls back to the eager operations otherwise.
+//	The plan p is reused if it fits the sequences of the expression.
+template<class E> Sequence Expression<E>::evaluate(AlignmentPlan& p) const
+{
+	std::vector<const Sequence*> terms;
+	self().collect(terms);
+	if(!p.fits(terms)) p=AlignmentPlan(terms);
+
+	Sequence::ManifestPointer manifest=p.manifest();
+	if(!manifest) return self().eager();
+
+	Sequence out(manifest); out.reserve(p.size());
+	for(unsigned i=0; i<p.size(); ++i) out.push_back(self().at(i));
+	return out;
+}
+
+#define _CNVEXPRESSION_OPERATOR_(symbol, op) \
+template<class L, class R> inline Binary<op,L,R> \
+	operator symbol(const Expression<L>& a, const Expression<R>& b) \
+	{ return Binary<op,L,R>(a.self(), b.self()); } \
+template<class L> inline Binary<op,L,Term> \
+	operator symbol(const Expression<L>& a, const Sequence& b) \
+	{ return Binary<op,L,Term>(a.self(), Term(b)); } \
+template<class R> inline Binary<op,Term,R> \
+	operator symbol(const Sequence& a, const Expression<R>& b) \
+	{ return Binary<op,Term,R>(Term(a), b.self()); }
+
+_CNVEXPRESSION_OPERATOR_(+, AddOp)
+_CNVEXPRESSION_OPERATOR_(-, SubOp)
+_CNVEXPRESSION_OPERATOR_(*, MulOp)
+_CNVEXPRESSION_OPERATOR_(/, DivOp)
+
+#undef _CNVEXPRESSION_OPERATOR_
+
+//	Scalars are broadcast the way sub and div in CnvOperations.cc are
+//	implemented, as addition of -p and multiplication with 1/p.
+template<class L> inline Binary<AddOp,L,Constant>
+	operator+(const Expression<L>& a, float p)
+	{ return Binary<AddOp,L,Constant>(a.self(), Constant(p)); }
+template<class L> inline Binary<MulOp,L,Constant>
+	operator*(const Expression<L>& a, float p)
+	{ return Binary<MulOp,L,Constant>(a.self(), Constant(p)); }
+template<class L> inline Binary<AddOp,L,Constant>
+	operator-(const Expression<L>& a, float p)
+	{ return Binary<AddOp,L,Constant>(a.self(), Constant(-p)); }
+template<class L> inline Binary<MulOp,L,Constant>
+	operator/(const Expression<L>& a, float p)
+	{ return Binary<MulOp,L,Constant>(a.self(), Constant(1.0f/p)); }
+
+template<class R> inline Binary<AddOp,Constant,R>
+	operator+(float p, const Expression<R>& a)
+	{ return Binary<AddOp,Constant,R>(Constant(p), a.self()); }
+template<class R> inline Binary<MulOp,Constant,R>
+	operator*(float p, const Expression<R>& a)
+	{ return Binary<MulOp,Constant,R>(Constant(p), a.self()); }
+
+}
+
+inline Lazy::Term lazy(const Sequence& s)
+	{ return Lazy::Term(s); }
+
+}
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ *      CnvFourier.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvFourier.hh"
+
+#include <glibmm.h>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+/* This file wraps the FFTW transforms used by Cnv::blur. Plans are created
+   once per transform length under a lock and shared by all threads, which
+   execute them concurrently on arrays of their own. Only the most recently
+   used plans are kept. The arrays come from a pool that all threads share,
+   because blur starts new threads for every call. The pool keeps at most
+   64MB of arrays that are not in use. Optionally, FFTW wisdom is read from
+   and written to a file, so that later runs start with measured plans. */
+
+namespace Cnv { namespace Fourier {
+
+namespace {
+
+//	plans kept while no Transform holds them, each with tables of the size of
+//	its transform
+const unsigned plan_cache_size=16;
+
+//	bytes of free scratch arrays the pool keeps at most, enough for the
+//	arrays of one full batch of blur
+const size_t free_buffer_bytes=(size_t)1<<26;
+
+class Plans
+{
+public:
+	fftw_plan forward;
+	fftw_plan backward;
+	unsigned users;
+	unsigned long long last_use;
+};
+
+typedef std::map<std::pair<unsigned,unsigned>,Plans> PlanMap;
+
+//	The FFTW planner is not thread safe, so everything but the execution of
+//	plans is serialized on this mutex.
+Glib::Threads::Mutex planner_mutex;
+PlanMap plans;
+unsigned long long plan_clock=0;
+unsigned planner_flags=FFTW_ESTIMATE;
+std::string wisdom_filename;
+
+//	Destroys the least recently used plans that no Transform holds while
+//	there are more than plan_cache_size. Called with planner_mutex locked.
+void evict_plans()
+{
+	while(plans.size()>plan_cache_size)
+	{
+		PlanMap::iterator oldest=plans.end();
+		for(PlanMap::iterator it=plans.begin(); it!=plans.end(); ++it)
+			if(it->second.users==0&&(oldest==plans.end()
+				||it->second.last_use<oldest->second.last_use))
+				oldest=it;
+		if(oldest==plans.end()) return;
+
+		fftw_destroy_plan(oldest->second.forward);
+		fftw_destroy_plan(oldest->second.backward);
+		plans.erase(oldest);
+	}
+}
+
+//	The free arrays of the pool with their sizes in bytes, and their sum.
+Glib::Threads::Mutex buffer_mutex;
+std::vector<std::pair<size_t,void*> > free_buffers;
+size_t free_bytes=0;
+
+}
+
+Transform::Transform(unsigned n, unsigned howmany)
+	:forward_plan(NULL),backward_plan(NULL),length(n),count(howmany)
+{
+	if(n==0||howmany==0) return;
+
+	planner_mutex.lock();
+	std::pair<unsigned,unsigned> key(n, howmany);
+	PlanMap::iterator it=plans.find(key);
+	if(it==plans.end())
+	{
+		int size=n;
+		int complex_size=n/2+1;
+		double* real=(double*)fftw_malloc((size_t)n*howmany*sizeof(double));
+		fftw_complex* complex=(fftw_complex*)
+			fftw_malloc((size_t)complex_size*howmany*sizeof(fftw_complex));
+
+		Plans p={ NULL, NULL, 0, 0 };
+		if(real!=NULL&&complex!=NULL)
+		{
+			p.forward=fftw_plan_many_dft_r2c(1, &size, howmany,
+				real, NULL, 1, size, complex, NULL, 1, complex_size,
+				planner_flags);
+			p.backward=fftw_plan_many_dft_c2r(1, &size, howmany,
+				complex, NULL, 1, complex_size, real, NULL, 1, size,
+				planner_flags);
+		}
+		if(complex!=NULL) fftw_free(complex);
+		if(real!=NULL) fftw_free(real);
+
+		if(p.forward!=NULL&&p.backward!=NULL)
+			it=plans.insert(std::make_pair(key, p)).first;
+		else
+		{
+			if(p.forward!=NULL) fftw_destroy_plan(p.forward);
+			if(p.backward!=NULL) fftw_destroy_plan(p.backward);
+		}
+	}
+	if(it!=plans.end())
+	{
+		it->second.users++;
+		it->second.last_use=++plan_clock;
+		forward_plan=it->second.forward;
+		backward_plan=it->second.backward;
+	}
+	evict_plans();
+	planner_mutex.unlock();
+}
+
+Transform::~Transform()
+{
+	if(!valid()) return;
+
+	planner_mutex.lock();
+	PlanMap::iterator it=plans.find(std::make_pair(length, count));
+	if(it!=plans.end()) it->second.users--;
+	evict_plans();
+	planner_mutex.unlock();
+}
+
+//	Hands out the smallest free array that is large enough, or a new one.
+void* acquire_buffer(size_t& bytes)
+{
+	bytes=std::max<size_t>(bytes, 1);
+
+	buffer_mutex.lock();
+	unsigned best=free_buffers.size();
+	for(unsigned k=0; k<free_buffers.size(); k++)
+		if(free_buffers[k].first>=bytes&&(best==free_buffers.size()
+			||free_buffers[k].first<free_buffers[best].first))
+			best=k;
+	void* data=NULL;
+	if(best<free_buffers.size())
+	{
+		bytes=free_buffers[best].first;
+		data=free_buffers[best].second;
+		free_buffers.erase(free_buffers.begin()+best);
+		free_bytes-=bytes;
+	}
+	buffer_mutex.unlock();
+
+	return (data!=NULL)?data:fftw_malloc(bytes);
+}
+
+//	Takes an array back into the pool. While the free arrays are larger than
+//	free_buffer_bytes together, the largest ones are freed, so that the pool
+//	never holds more memory than that beyond the arrays in use.
+void release_buffer(void* data, size_t bytes)
+{
+	if(data==NULL) return;
+
+	std::vector<void*> freed;
+	buffer_mutex.lock();
+	free_buffers.push_back(std::make_pair(bytes, data));
+	free_bytes+=bytes;
+	while(free_bytes>free_buffer_bytes)
+	{
+		std::vector<std::pair<size_t,void*> >::iterator it=
+			std::max_element(free_buffers.begin(), free_buffers.end());
+		freed.push_back(it->second);
+		free_bytes-=it->first;
+		free_buffers.erase(it);
+	}
+	buffer_mutex.unlock();
+
+	for(unsigned k=0; k<freed.size(); k++) fftw_free(freed[k]);
+}
+
+unsigned smooth_length(unsigned n)
+{
+	unsigned long long best=1;
+	while(best<n) best*=2;
+
+	for(unsigned long long f7=1; f7<best; f7*=7)
+		for(unsigned long long f5=f7; f5<best; f5*=5)
+			for(unsigned long long f3=f5; f3<best; f3*=3)
+			{
+				unsigned long long m=f3;
+				while(m<n) m*=2;
+				if(m<best) best=m;
+			}
+
+	return (best<=0xffffffffull)?best:n;
+}
+
+void reflect(double* data, unsigned n, unsigned before, unsigned after)
+{
+	if(n==0) return;
+	long long period=2*(long long)n;
+	for(long long i=-(long long)before; i<(long long)n+after; i++)
+	{
+		if(i==0) i=n;
+		long long k=((i%period)+period)%period;
+		data[i]=data[(k<n)?k:period-1-k];
+	}
+}
+
+//	Imports the wisdom in filename, if the file exists, and measures all
+//	plans created from now on. save_wisdom writes the accumulated wisdom back.
+bool use_wisdom(const std::string& filename)
+{
+	planner_mutex.lock();
+	wisdom_filename=filename;
+	planner_flags=FFTW_MEASURE;
+	bool success=fftw_import_wisdom_from_filename(filename.c_str())!=0;
+	planner_mutex.unlock();
+	return success;
+}
+
+bool save_wisdom()
+{
+	planner_mutex.lock();
+	bool success=!wisdom_filename.empty()
+		&&fftw_export_wisdom_to_filename(wisdom_filename.c_str())!=0;
+	planner_mutex.unlock();
+	return success;
+}
+
+} }
@@ -0,0 +1,104 @@
+/*
+ *      CnvFourier.hh - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CNVFOURIER_
+#define _CNVFOURIER_
+#include <fftw3.h>
+#include <string>
+#include <cstddef>
+
+/* This file wraps the FFTW transforms used by Cnv::blur. Plans are created
+   once per transform length under a lock and shared by all threads, which
+   execute them concurrently on arrays of their own. Only the most recently
+   used plans are kept. The arrays come from a pool that all threads share,
+   because blur starts new threads for every call. The pool keeps at most
+   64MB of arrays that are not in use. Optionally, FFTW wisdom is read from
+   and written to a file, so that later runs start with measured plans. */
+
+namespace Cnv { namespace Fourier {
+
+//	The real to complex and complex to real transforms of length n, applied
+//	to howmany consecutive arrays of n real and n/2+1 complex values. The
+//	arrays must have been allocated with fftw_malloc, like those of Buffer.
+//	The plans stay cached at least as long as the Transform exists.
+class Transform
+{
+public:
+	explicit Transform(unsigned n, unsigned howmany=1);
+	~Transform();
+
+	bool valid() const { return forward_plan!=NULL&&backward_plan!=NULL; }
+
+	void forward(double* in, fftw_complex* out) const
+		{ fftw_execute_dft_r2c(forward_plan, in, out); }
+	void backward(fftw_complex* in, double* out) const
+		{ fftw_execute_dft_c2r(backward_plan, in, out); }
+
+private:
+	Transform(const Transform&);
+	Transform& operator=(const Transform&);
+
+	fftw_plan forward_plan;
+	fftw_plan backward_plan;
+	unsigned length;
+	unsigned count;
+};
+
+void*	acquire_buffer	(size_t& bytes);
+void	release_buffer	(void* data, size_t bytes);
+
+//	A scratch array with room for at least n values, taken from the shared
+//	pool and given back to it on destruction. data() is NULL if no memory is
+//	left.
+template<class T> class Buffer
+{
+public:
+	explicit Buffer(size_t n):bytes(n*sizeof(T))
+		{ array=(T*)acquire_buffer(bytes); }
+	~Buffer() { release_buffer(array, bytes); }
+
+	T* data() const { return array; }
+
+private:
+	Buffer(const Buffer&);
+	Buffer& operator=(const Buffer&);
+
+	size_t bytes;
+	T* array;
+};
+
+typedef Buffer<double>			RealBuffer;
+typedef Buffer<fftw_complex>	ComplexBuffer;
+
+//	The smallest length of at least n without prime factors above 7. FFTW
+//	transforms these lengths with its fast algorithms.
+unsigned	smooth_length	(unsigned n);
+
+//	Fills the size values around data[0], ..., data[n-1] by mirroring it at
+//	its ends, data[-1]=data[0], data[n]=data[n-1] and so on. The values
+//	before data are filled from data[-before] on, those after it up to
+//	data[n+after-1].
+void	reflect	(double* data, unsigned n, unsigned before, unsigned after);
+
+bool	use_wisdom	(const std::string& filename);
+bool	save_wisdom	();
+
+} }
+
+#endif
@@ -0,0 +1,543 @@
+/*
+ *      CnvKernels.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvKernels.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <utility>
+
+/* This file defines the kernels behind the unary operations of
+   CnvOperations.hh. They transform a raw column of n floats from in to out,
+   which may be the same array. The instruction set is chosen at runtime:
+   AVX2 if the processor supports it, SSE2 on other x86 processors and plain
+   scalar code elsewhere. All three compute exactly the same floats.
+
+   abs and trunc are exact. exp, log and erf are polynomial approximations
+   within 1 ulp of the correctly rounded result, checked over all floats.
+   pow follows Cnv::pow and multiplies pow(|x|, p) with cos(pi*p) for
+   negative x. Where |p*log|x|| is at most 8 it is computed in float and
+   stays within 3 ulp of the correctly rounded result for the exponents that
+   were checked, everywhere else it is computed in double like Cnv::pow
+   always was. NaN and Inf are handled like the C library does.
+
+   median reorders an array of n floats in place and returns the median of
+   the values that are not NaN, the mean of the two middle values for an even
+   count. Small arrays are sorted by networks that are unrolled at compile
+   time, larger ones are partially sorted by std::nth_element.
+
+   separators finds the tabs and newlines in a block of characters, so that
+   the loaders can split lines into columns without looking at every
+   character on their own. */
+
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#define _CNVKERNELS_AVX2_
+//	The kernels are always inlined, so the ABI of wide vector return values
+//	that gcc warns about is never used.
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#define _CNVKERNELS_INLINE_ inline __attribute__((always_inline))
+
+namespace Cnv { namespace Kernel {
+
+namespace {
+
+//	The kernels are written once with the vector extensions of gcc and
+//	instantiated for vectors of one, four and eight floats. They are inlined
+//	into the functions at the bottom, which are compiled for the different
+//	instruction sets.
+typedef float Float1 __attribute__((vector_size(4)));
+typedef int Int1 __attribute__((vector_size(4)));
+typedef float Float4 __attribute__((vector_size(16)));
+typedef int Int4 __attribute__((vector_size(16)));
+typedef float Float8 __attribute__((vector_size(32)));
+typedef int Int8 __attribute__((vector_size(32)));
+
+template<class F> struct Lanes {};
+template<> struct Lanes<Float1> { typedef Int1 Int; };
+template<> struct Lanes<Float4> { typedef Int4 Int; };
+template<> struct Lanes<Float8> { typedef Int8 Int; };
+
+template<class F> _CNVKERNELS_INLINE_ F splat(float v)
+	{ return F{}+v; }
+
+//	Cephes expf: x=n*log(2)+r with |r|<=log(2)/2, exp(r) by a polynomial.
+//	The power of two is applied in two steps to reach the subnormal range.
+//	The tail is a small correction to x that is added to r.
+template<class F> _CNVKERNELS_INLINE_ F exp_kernel(const F& x, const F& tail)
+{
+	typedef typename Lanes<F>::Int I;
+
+	F c=(x!=x)?F{}:x;
+	c=(c<-104.0f)?splat<F>(-104.0f):c;
+	c=(c>89.0f)?splat<F>(89.0f):c;
+
+	F t=c*1.44269504088896341f+0.5f;
+	I n=__builtin_convertvector(t, I);
+	n+=(__builtin_convertvector(n, F)>t);
+	F fn=__builtin_convertvector(n, F);
+
+	F r=c-fn*0.693359375f;
+	r=r-fn*-2.12194440e-4f;
+	r=r+tail;
+	F z=r*r;
+
+	F y=splat<F>(1.9875691500e-4f);
+	y=y*r+1.3981999507e-3f;
+	y=y*r+8.3334519073e-3f;
+	y=y*r+4.1665795894e-2f;
+	y=y*r+1.6666665459e-1f;
+	y=y*r+5.0000001201e-1f;
+	y=y*z+r+1.0f;
+
+	I n1=n>>1;
+	I n2=n-n1;
+	y=y*(F)((n1+127)<<23);
+	y=y*(F)((n2+127)<<23);
+	return (x!=x)?x:y;
+}
+
+//	Cephes logf: x=2^e*m with sqrt(1/2)<=m<sqrt(2), log(m) by a polynomial.
+//	Subnormals are scaled by 2^23 first. The rounding errors of the final
+//	two additions are returned in tail.
+template<class F> _CNVKERNELS_INLINE_ F log_kernel(const F& x, F& tail)
+{
+	typedef typename Lanes<F>::Int I;
+
+	I small=(x<1.17549435e-38f);
+	F c=small?x*8388608.0f:x;
+	I bits=(I)c;
+	I e=((bits>>23)&0xff)-126-(small&23);
+	F m=(F)((bits&0x007fffff)|0x3f000000);
+
+	I low=(m<0.707106781186547524f);
+	e+=low;
+	m=low?(m+m-1.0f):(m-1.0f);
+	F z=m*m;
+
+	F y=splat<F>(7.0376836292e-2f);
+	y=y*m-1.1514610310e-1f;
+	y=y*m+1.1676998740e-1f;
+	y=y*m-1.2420140846e-1f;
+	y=y*m+1.4249322787e-1f;
+	y=y*m-1.6668057665e-1f;
+	y=y*m+2.0000714765e-1f;
+	y=y*m-2.4999993993e-1f;
+	y=y*m+3.3333331174e-1f;
+	y=y*m*z;
+
+	F fe=__builtin_convertvector(e, F);
+	y=y+fe*-2.12194440e-4f;
+	y=y-z*0.5f;
+	F s=m+y;
+	F t=fe*0.693359375f;
+	F out=s+t;
+	F v=out-s;
+	tail=(y-(s-m))+((s-(out-v))+(t-v));
+
+	out=(x==0.0f)?splat<F>(-HUGE_VALF):out;
+	out=(x<0.0f)?splat<F>(NAN):out;
+	out=(x==HUGE_VALF)?x:out;
+	return (x!=x)?x:out;
+}
+
+//	Chebyshev fits of erf(x)/x-1 over x*x in [0,1) and of erf(x) over
+//	[1,2), [2,3) and [3,4). Above 4, erf(x) rounds to 1.
+const float erf_coefficients[4][11]={
+	{ 1.283791670e-01f, -3.761263847e-01f, 1.128378250e-01f,
+		-2.686543073e-02f, 5.221031808e-03f, -8.484080406e-04f,
+		1.126595903e-04f, -9.667044572e-06f, 0.0f, 0.0f, 0.0f },
+	{ 9.661051465e-01f, 1.189302867e-01f, -1.783954331e-01f,
+		1.387522073e-01f, -4.459891604e-02f, -1.487085004e-02f,
+		1.932746979e-02f, -4.701123305e-03f, -2.374689619e-03f,
+		1.540339842e-03f, -4.358005144e-05f },
+	{ 9.995930480e-01f, 2.178284316e-03f, -5.445710722e-03f,
+		8.350082737e-03f, -8.622363407e-03f, 6.117498245e-03f,
+		-2.798751783e-03f, 5.410861645e-04f, 2.630653679e-04f,
+		-2.454109717e-04f, 6.919432338e-05f },
+	{ 9.999992569e-01f, 5.399429253e-06f, -1.889798843e-05f,
+		4.229530849e-05f, -6.771823347e-05f, 8.212097440e-05f,
+		-7.773483157e-05f, 5.814646631e-05f, -3.434428573e-05f,
+		1.554528649e-05f, -4.309066981e-06f }
+};
+
+template<class F> _CNVKERNELS_INLINE_ F erf_kernel(const F& x)
+{
+	typedef typename Lanes<F>::Int I;
+
+	I sign=(I)x&(int)0x80000000;
+	F a=(F)((I)x&0x7fffffff);
+	I region=__builtin_convertvector((a<4.0f)?a:splat<F>(4.0f), I);
+	F v=(region==0)?a*a:a-(__builtin_convertvector(region, F)+0.5f);
+
+	F y=F{};
+	for(int i=10; i>=0; --i)
+	{
+		F c=(region==0)?splat<F>(erf_coefficients[0][i])
+			:(region==1)?splat<F>(erf_coefficients[1][i])
+			:(region==2)?splat<F>(erf_coefficients[2][i])
+			:splat<F>(erf_coefficients[3][i]);
+		y=y*v+c;
+	}
+
+	y=(region==0)?a+a*y:y;
+	y=(region>=4)?splat<F>(1.0f):y;
+	y=(F)((I)y|sign);
+	return (x!=x)?x:y;
+}
+
+template<class F> _CNVKERNELS_INLINE_ F abs_kernel(const F& x)
+{
+	typedef typename Lanes<F>::Int I;
+	return (F)((I)x&0x7fffffff);
+}
+
+class Exp
+{
+public:
+	template<class F> _CNVKERNELS_INLINE_ F operator()(const F& x) const
+		{ return exp_kernel(x, F{}); }
+};
+
+class Log
+{
+public:
+	template<class F> _CNVKERNELS_INLINE_ F operator()(const F& x) const
+		{ F tail; return log_kernel(x, tail); }
+};
+
+class Erf
+{
+public:
+	template<class F> _CNVKERNELS_INLINE_ F operator()(const F& x) const
+		{ return erf_kernel(x); }
+};
+
+class Abs
+{
+public:
+	template<class F> _CNVKERNELS_INLINE_ F operator()(const F& x) const
+		{ return abs_kernel(x); }
+};
+
+//	pow(|x|, p), multiplied with cos(pi*p) for negative x as in Cnv::pow.
+//	The product p*log|x| is carried with its rounding error, which is
+//	computed exactly by splitting both factors into halves of 12 bits.
+class Pow
+{
+public:
+	Pow(float p, float f):exponent(p),factor(f),high(p),low(0.0f)
+	{
+		if(fabs(p)>1e30f) return;
+		float c=p*4097.0f;
+		high=c-(c-p);
+		low=p-high;
+	}
+
+	template<class F> _CNVKERNELS_INLINE_ F operator()(const F& x) const
+	{
+		F tail;
+		F l=log_kernel(abs_kernel(x), tail);
+		F y=l*exponent;
+
+		F c=l*4097.0f;
+		F h=c-(c-l);
+		F g=l-h;
+		F e=((h*high-y)+h*low+g*high)+g*low+tail*exponent;
+		e=(y<128.0f&&y>-128.0f)?e:F{};
+
+		y=exp_kernel(y, e);
+		return y*((x>=0.0f)?splat<F>(1.0f):splat<F>(factor));
+	}
+
+private:
+	float exponent;
+	float factor;
+	float high;
+	float low;
+};
+
+//	Clamps x to [-p,p] like std::min(std::max(x, -p), p), keeping NaN.
+class Trunc
+{
+public:
+	Trunc(float p):bound(p) {}
+
+	template<class F> _CNVKERNELS_INLINE_ F operator()(const F& x) const
+	{
+		F t=(x<-bound)?splat<F>(-bound):x;
+		t=(bound<t)?splat<F>(bound):t;
+		return (x!=x)?x:t;
+	}
+
+private:
+	float bound;
+};
+
+template<class F, class Op> _CNVKERNELS_INLINE_
+	void transform(const float* in, float* out, unsigned n, const Op& op)
+{
+	unsigned i=0;
+	for(; i+sizeof(F)/sizeof(float)<=n; i+=sizeof(F)/sizeof(float))
+	{
+		F v;
+		memcpy(&v, in+i, sizeof(F));
+		v=op(v);
+		memcpy(out+i, &v, sizeof(F));
+	}
+	for(; i<n; ++i)
+	{
+		Float1 v={in[i]};
+		out[i]=op(v)[0];
+	}
+}
+
+//	Writes the offsets of the tabs and newlines among the n characters at data
+//	to out and returns their number. The vector versions compare a block of
+//	characters at once and walk the set bits of the resulting mask.
+unsigned scalar_separators(const char* data, unsigned n, unsigned* out)
+{
+	unsigned count=0;
+	for(unsigned i=0; i<n; ++i)
+		if(data[i]=='\t'||data[i]=='\n') out[count++]=i;
+	return count;
+}
+
+#ifdef _CNVKERNELS_AVX2_
+typedef char Char16 __attribute__((vector_size(16)));
+typedef char Char32 __attribute__((vector_size(32)));
+
+__attribute__((target("sse2")))
+unsigned sse2_separators(const char* data, unsigned n, unsigned* out)
+{
+	unsigned count=0, i=0;
+	for(; i+sizeof(Char16)<=n; i+=sizeof(Char16))
+	{
+		Char16 v;
+		memcpy(&v, data+i, sizeof(Char16));
+		unsigned bits=__builtin_ia32_pmovmskb128(
+			(Char16)((v==(Char16{}+'\t'))|(v==(Char16{}+'\n'))));
+		for(; bits!=0; bits&=bits-1) out[count++]=i+__builtin_ctz(bits);
+	}
+	for(; i<n; ++i)
+		if(data[i]=='\t'||data[i]=='\n') out[count++]=i;
+	return count;
+}
+
+__attribute__((target("avx2")))
+unsigned avx2_separators(const char* data, unsigned n, unsigned* out)
+{
+	unsigned count=0, i=0;
+	for(; i+sizeof(Char32)<=n; i+=sizeof(Char32))
+	{
+		Char32 v;
+		memcpy(&v, data+i, sizeof(Char32));
+		unsigned bits=__builtin_ia32_pmovmskb256(
+			(Char32)((v==(Char32{}+'\t'))|(v==(Char32{}+'\n'))));
+		for(; bits!=0; bits&=bits-1) out[count++]=i+__builtin_ctz(bits);
+	}
+	for(; i<n; ++i)
+		if(data[i]=='\t'||data[i]=='\n') out[count++]=i;
+	return count;
+}
+#endif
+
+class Table
+{
+public:
+	void (*exp)(const float*, float*, unsigned);
+	void (*log)(const float*, float*, unsigned);
+	void (*erf)(const float*, float*, unsigned);
+	void (*abs)(const float*, float*, unsigned);
+	void (*pow)(const float*, float*, unsigned, float, float);
+	void (*trunc)(const float*, float*, unsigned, float);
+	unsigned (*separators)(const char*, unsigned, unsigned*);
+	const char* name;
+};
+
+#define _CNVKERNELS_TABLE_(table, F, attributes, label) \
+attributes void table##_exp(const float* in, float* out, unsigned n) \
+	{ transform<F>(in, out, n, Exp()); } \
+attributes void table##_log(const float* in, float* out, unsigned n) \
+	{ transform<F>(in, out, n, Log()); } \
+attributes void table##_erf(const float* in, float* out, unsigned n) \
+	{ transform<F>(in, out, n, Erf()); } \
+attributes void table##_abs(const float* in, float* out, unsigned n) \
+	{ transform<F>(in, out, n, Abs()); } \
+attributes void table##_pow(const float* in, float* out, unsigned n, \
+	float p, float f) { transform<F>(in, out, n, Pow(p, f)); } \
+attributes void table##_trunc(const float* in, float* out, unsigned n, \
+	float p) { transform<F>(in, out, n, Trunc(p)); } \
+const Table table={ table##_exp, table##_log, table##_erf, table##_abs, \
+	table##_pow, table##_trunc, table##_separators, label };
+
+_CNVKERNELS_TABLE_(scalar, Float1, , "scalar")
+#ifdef _CNVKERNELS_AVX2_
+_CNVKERNELS_TABLE_(sse2, Float4, __attribute__((target("sse2"))), "sse2")
+_CNVKERNELS_TABLE_(avx2, Float8, __attribute__((target("avx2"))), "avx2")
+#endif
+
+#undef _CNVKERNELS_TABLE_
+
+const Table& select()
+{
+#ifdef _CNVKERNELS_AVX2_
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) return avx2;
+	if(__builtin_cpu_supports("sse2")) return sse2;
+#endif
+	return scalar;
+}
+
+const Table& table()
+{
+	static const Table& t=select();
+	return t;
+}
+
+//	Knuth's merge exchange sort (TAOCP 5.2.2, algorithm M), a sorting network
+//	for any N. With N known at compile time, all loops are unrolled into a
+//	branch free sequence of min and max operations.
+template<unsigned N> void sort_network(float* v)
+{
+	unsigned t=0;
+	while((1u<<t)<N) ++t;
+	for(unsigned p=(t>0)?1u<<(t-1):0; p>0; p>>=1)
+	{
+		unsigned q=1u<<(t-1), r=0, d=p;
+		for(;;)
+		{
+			for(unsigned i=0; i+d<N; ++i)
+				if((i&p)==r)
+				{
+					float a=v[i], b=v[i+d];
+					v[i]=std::min(a, b);
+					v[i+d]=std::max(a, b);
+				}
+			if(q==p) break;
+			d=q-p; q>>=1; r=p;
+		}
+	}
+}
+
+typedef void (*Network)(float*);
+const Network networks[]={
+	sort_network<0>, sort_network<1>, sort_network<2>, sort_network<3>,
+	sort_network<4>, sort_network<5>, sort_network<6>, sort_network<7>,
+	sort_network<8>, sort_network<9>, sort_network<10>, sort_network<11>,
+	sort_network<12>, sort_network<13>, sort_network<14>, sort_network<15>,
+	sort_network<16>, sort_network<17>, sort_network<18>, sort_network<19>,
+	sort_network<20>, sort_network<21>, sort_network<22>, sort_network<23>,
+	sort_network<24>, sort_network<25>, sort_network<26>, sort_network<27>,
+	sort_network<28>, sort_network<29>, sort_network<30>, sort_network<31>,
+	sort_network<32> };
+
+}
+
+void exp(const float* in, float* out, unsigned n)
+	{ table().exp(in, out, n); }
+void log(const float* in, float* out, unsigned n)
+	{ table().log(in, out, n); }
+void erf(const float* in, float* out, unsigned n)
+	{ table().erf(in, out, n); }
+void abs(const float* in, float* out, unsigned n)
+	{ table().abs(in, out, n); }
+void trunc(const float* in, float* out, unsigned n, float p)
+	{ table().trunc(in, out, n, p); }
+unsigned separators(const char* data, unsigned n, unsigned* out)
+	{ return table().separators(data, n, out); }
+
+//	The error of the float kernel grows with |p*log|x||, because the error of
+//	log is multiplied with p. Outside of pow_kernel_range the values are
+//	computed in double like Cnv::pow did before, where cos(pi*p) is applied
+//	before rounding, so that a result does not overflow early. NaN and Inf
+//	are outside as well.
+namespace {
+
+const float pow_kernel_range=8.0f;
+
+float pow_double(float x, float p, float f)
+{
+	return ::pow(fabs((double)x), (double)p)*((x>=0)?1.0:(double)f);
+}
+
+}
+
+//	The identities pow(x, 0)=1 and pow(1, p)=1 hold for NaN arguments in the
+//	C library, but not for exp(p*log x). Such exponents are left to ::pow.
+//	The values outside of the range of the kernel are noted before the
+//	kernel runs, since in and out may be the same array.
+void pow(const float* in, float* out, unsigned n, float p)
+{
+	float f=cosf(M_PI*p);
+	if(p==0.0f||!std::isfinite(p))
+	{
+		for(unsigned i=0; i<n; ++i) out[i]=pow_double(in[i], p, f);
+		return;
+	}
+
+	double bound=::exp(pow_kernel_range/fabs(p));
+	float low=1.0/bound, high=std::min(bound, 3.4028234663852886e38);
+	std::vector<std::pair<unsigned,float> > outside;
+	for(unsigned i=0; i<n; ++i)
+		if(!(fabs(in[i])>=low&&fabs(in[i])<=high))
+			outside.push_back(std::make_pair(i, in[i]));
+
+	table().pow(in, out, n, p, f);
+	for(unsigned k=0; k<outside.size(); ++k)
+		out[outside[k].first]=pow_double(outside[k].second, p, f);
+}
+
+//	The values that are not NaN are moved to the front first. An array of
+//	NaN has the median NaN, an empty one the median 0 as in Cnv::median.
+float median(float* values, unsigned n)
+{
+	if(n==0) return 0.0f;
+
+	unsigned m=0;
+	for(unsigned i=0; i<n; ++i)
+		if(!std::isnan(values[i])) values[m++]=values[i];
+	if(m==0) return NAN;
+
+	float lower, upper;
+	if(m<sizeof(networks)/sizeof(Network))
+	{
+		networks[m](values);
+		lower=values[(m-1)/2];
+		upper=values[m/2];
+	}
+	else
+	{
+		std::nth_element(values, values+m/2, values+m);
+		upper=values[m/2];
+		lower=(m%2==0)?*std::max_element(values, values+m/2):upper;
+	}
+
+	if(m%2==1) return upper;
+	return (lower+upper)/2.0;
+}
+
+const char* instruction_set()
+{
+	return table().name;
+}
+
+} }
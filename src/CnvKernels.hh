@@ -0,0 +1,63 @@
+/*
+ *      CnvKernels.hh - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CNVKERNELS_
+#define _CNVKERNELS_
+
+/* This file defines the kernels behind the unary operations of
+   CnvOperations.hh. They transform a raw column of n floats from in to out,
+   which may be the same array. The instruction set is chosen at runtime:
+   AVX2 if the processor supports it, SSE2 on other x86 processors and plain
+   scalar code elsewhere. All three compute exactly the same floats.
+
+   abs and trunc are exact. exp, log and erf are polynomial approximations
+   within 1 ulp of the correctly rounded result, checked over all floats.
+   pow follows Cnv::pow and multiplies pow(|x|, p) with cos(pi*p) for
+   negative x. Where |p*log|x|| is at most 8 it is computed in float and
+   stays within 3 ulp of the correctly rounded result for the exponents that
+   were checked, everywhere else it is computed in double like Cnv::pow
+   always was. NaN and Inf are handled like the C library does.
+
+   median reorders an array of n floats in place and returns the median of
+   the values that are not NaN, the mean of the two middle values for an even
+   count. Small arrays are sorted by networks that are unrolled at compile
+   time, larger ones are partially sorted by std::nth_element.
+
+   separators finds the tabs and newlines in a block of characters, so that
+   the loaders can split lines into columns without looking at every
+   character on their own. */
+
+namespace Cnv { namespace Kernel {
+
+void	exp		(const float* in, float* out, unsigned n);
+void	log		(const float* in, float* out, unsigned n);
+void	erf		(const float* in, float* out, unsigned n);
+void	abs		(const float* in, float* out, unsigned n);
+void	pow		(const float* in, float* out, unsigned n, float p);
+void	trunc	(const float* in, float* out, unsigned n, float p);
+
+float	median	(float* values, unsigned n);
+
+unsigned	separators	(const char* data, unsigned n, unsigned* out);
+
+const char* instruction_set();
+
+} }
+
+#endif
@@ -22,6 +22,8 @@
 #include "CnvSequence.hh"
 #include "CnvStringPool.hh"
 #include "CnvEncodeDecode.hh"
+#include "CnvMappedFile.hh"
+#include "CnvOutputFile.hh"
 
 #include <cmath>
 #include <string>
@@ -29,6 +31,9 @@
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <cstring>
+#include <climits>
+#include <glibmm.h>
 
 /* This file defines the fundamental load and save routines for data sequences.
    Both the load and the save function make use of the native file format
@@ -36,51 +41,120 @@
    outsourced to the PennCnvLoadSave.hh file.
 
    In addition to the filename, the load function receives a StringPool object
-   reference which it uses to minimize memory footprint. */
+   reference which it uses to minimize memory footprint. The file is mapped
+   into memory and parsed in parallel, "-" loads the standard input. */
 
 namespace Cnv {
 
-Sequence load(std::string f, StringPool& pool)
-{
-	Sequence out;
-	std::ifstream ifs(f.c_str());
-
-	std::string line;
-	while(std::getline(ifs, line))
-	{
-		size_t id_start=0, id_end=0, value_start=0, value_end=0;
+namespace {
 
-		while(id_start<line.size()&&(line[id_start]==' '
-			||line[id_start]=='\t')) id_start++;
+//	Bytes per thread below which starting another thread does not pay.
+const size_t load_thread_bytes=1<<20;
 
-		id_end=id_start;
-		while(id_end<line.size()&&line[id_end]!=' '
-			&&line[id_end]!='\t') id_end++;
+//	The data points parsed from a piece of a file that begins at the start of
+//	a line. The names are interned straight from the file contents.
+class LoadChunk
+{
+public:
 
-		value_start=id_end;
-		while(value_start<line.size()&&(line[value_start]==' '
-			||line[value_start]=='\t')) value_start++;
+	void parse(const char* i, const char* end, StringPool* pool)
+	{
+		while(i<end)
+		{
+			const char* line_end=(const char*)memchr(i, '\n', end-i);
+			if(line_end==NULL) line_end=end;
+
+			const char* id_start=i;
+			while(id_start<line_end&&(*id_start==' '||*id_start=='\t'))
+				id_start++;
+
+			const char* id_end=id_start;
+			while(id_end<line_end&&*id_end!=' '&&*id_end!='\t') id_end++;
+
+			const char* value_start=id_end;
+			while(value_start<line_end&&(*value_start==' '
+				||*value_start=='\t')) value_start++;
+
+			const char* value_end=value_start;
+			while(value_end<line_end&&*value_end!=' '
+				&&*value_end!='\t') value_end++;
+
+			if(id_end>id_start)
+			{
+				unsigned char chr=UCHAR_MAX;
+				unsigned pos=0;
+				decompose_point_name(id_start, id_end, chr, pos);
+
+				names.push_back((*pool)(id_start, id_end-id_start));
+				values.push_back(decode_float_value(value_start, value_end));
+				chromosomes.push_back(chr);
+				positions.push_back(pos);
+			}
+
+			i=line_end+1;
+		}
+	}
 
-		value_end=value_start;
-		while(value_end<line.size()&&line[value_end]!=' '
-			&&line[value_end]!='\t') value_end++;
+	std::vector<StringPointer> names;
+	std::vector<float> values;
+	std::vector<unsigned char> chromosomes;
+	std::vector<unsigned> positions;
+};
 
+}
 
-		std::string name=line.substr(id_start, id_end-id_start);
+//	The file is split into pieces at line breaks, which are parsed on one
+//	thread per processor and appended in order.
+Sequence load(std::string f, StringPool& pool)
+{
+	MappedFile file(f);
+	Glib::Timer timer;
+	std::vector<size_t> pieces=file.split(Glib::get_num_processors(),
+		load_thread_bytes);
+
+	std::vector<LoadChunk> chunks(pieces.size()-1);
+	std::vector<Glib::Threads::Thread*> workers;
+	for(unsigned k=1; k<chunks.size(); ++k)
+		workers.push_back(Glib::Threads::Thread::create(sigc::bind(
+			sigc::mem_fun(chunks[k], &LoadChunk::parse),
+			file.data()+pieces[k], file.data()+pieces[k+1], &pool)));
+	if(!chunks.empty())
+		chunks[0].parse(file.data(), file.data()+pieces[1], &pool);
+	for(unsigned k=0; k<workers.size(); ++k)
+		workers[k]->join();
+
+	size_t total=0;
+	for(unsigned k=0; k<chunks.size(); ++k)
+		total+=chunks[k].names.size();
 
-		float value=decode_float_value(
-			line.begin()+value_start, line.begin()+value_end);
-		if(name.size()>0) out.push_back(pool(name), value);
+	Sequence out;
+	out.reserve(total);
+	for(unsigned k=0; k<chunks.size(); ++k)
+	{
+		for(unsigned j=0; j<chunks[k].names.size(); ++j)
+			out.push_back(chunks[k].names[j], chunks[k].values[j],
+				chunks[k].chromosomes[j], chunks[k].positions[j]);
+		chunks[k]=LoadChunk();
 	}
+	add_load_stats(LoadStats::parse, file.size(), timer.elapsed());
 	return out;
 }
 
+//	Every line is formatted straight into the buffer of the file.
 void save(const Sequence& s, std::string f)
 {
-	std::ofstream ofs(f.c_str());
+	OutputFile file(f);
 
 	for(SequenceSingleIterator iter(s); iter; ++iter)
-		ofs<<(std::string)iter.name()<<"\t"<<encode_float_value(iter.value())<<"\n";
+	{
+		StringPointer name=iter.name();
+		file.write(name.c_str(), name.length());
+		char* out=file.reserve(float_value_chars+2);
+		*(out++)='\t';
+		out=format_float_value(iter.value(), out);
+		*(out++)='\n';
+		file.commit(out);
+	}
 }
 
 }
@@ -31,7 +31,8 @@
    outsourced to the PennCnvLoadSave.hh file.
 
    In addition to the filename, the load function receives a StringPool object
-   reference which it uses to minimize memory footprint. */
+   reference which it uses to minimize memory footprint. The file is mapped
+   into memory and parsed in parallel, "-" loads the standard input. */
 
 namespace Cnv {
 
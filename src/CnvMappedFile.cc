@@ -0,0 +1,377 @@
+/*
+ *      CnvMappedFile.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvMappedFile.hh"
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <zlib.h>
+#include <glibmm.h>
+
+/* This file gives the loaders the whole contents of a file as one block of
+   characters. Regular files are mapped into memory, so that they are parsed
+   straight from the page cache without being copied. The standard input,
+   pipes and everything else that cannot be mapped is read into a buffer
+   instead. The name "-" stands for the standard input. A file that cannot be
+   read completely yields no contents at all, never a part of them.
+
+   Files that begin with the gzip magic bytes are decompressed into a buffer
+   with zlib, as a whole, because the loaders split their input into pieces
+   for several threads. Damaged or cut off compressed files yield no
+   contents and are not good. BGZF files, which are gzip files made of small
+   independent blocks, are decompressed on one thread per processor, block
+   by block.
+   The time spent reading, decompressing and parsing is summed up for all
+   files and can be queried with load_stats. */
+
+namespace Cnv {
+
+namespace {
+
+//	compressed bytes per thread below which another thread doesn't pay
+const size_t inflate_thread_bytes=1<<20;
+
+//	zlib takes at most this many bytes at once
+const size_t inflate_step=1<<30;
+
+//	deflate compresses no data more than about this many times
+const unsigned long long deflate_ratio=1032;
+
+Glib::Threads::Mutex stats_mutex;
+LoadStats stats_total={{0, 0, 0}, {0, 0, 0}};
+
+unsigned little_endian(const unsigned char* p, unsigned n)
+{
+	unsigned out=0;
+	for(unsigned k=n; k>0; --k) out=out<<8|p[k-1];
+	return out;
+}
+
+//	A BGZF block, where its deflated data starts in the file and where its
+//	contents go in the buffer.
+struct BgzfBlock
+{
+	size_t in, in_size;
+	size_t out, out_size;
+	unsigned crc;
+};
+
+//	Finds the blocks of a BGZF file. Every block is a gzip member with only
+//	the extra field set, which holds the size of the block in a subfield
+//	named "BC". Returns false if the file is not made of such blocks.
+bool bgzf_blocks(const unsigned char* data, size_t length,
+	std::vector<BgzfBlock>& blocks)
+{
+	size_t at=0, out=0;
+	while(at<length)
+	{
+		const unsigned char* p=data+at;
+		if(length-at<18||p[0]!=31||p[1]!=139||p[2]!=8||p[3]!=4) return false;
+
+		size_t xlen=little_endian(p+10, 2), size=0;
+		if(length-at<12+xlen) return false;
+		for(size_t sub=12; sub+4<=12+xlen; sub+=4+little_endian(p+sub+2, 2))
+			if(p[sub]=='B'&&p[sub+1]=='C'&&little_endian(p+sub+2, 2)==2
+				&&sub+6<=12+xlen)
+				size=little_endian(p+sub+4, 2)+1;
+		if(size<12+xlen+8||size>length-at) return false;
+
+		BgzfBlock b;
+		b.in=at+12+xlen;
+		b.in_size=size-12-xlen-8;
+		b.out=out;
+		b.out_size=little_endian(p+size-4, 4);
+		b.crc=little_endian(p+size-8, 4);
+		if(b.out_size>65536) return false;
+		blocks.push_back(b);
+
+		out+=b.out_size;
+		at+=size;
+	}
+	return !blocks.empty();
+}
+
+//	Inflates a range of BGZF blocks and checks their sizes and checksums.
+class BgzfRange
+{
+public:
+
+	BgzfRange():ok(false) {}
+
+	void inflate(const std::vector<BgzfBlock>* blocks, unsigned first,
+		unsigned last, const unsigned char* in, unsigned char* out);
+
+	bool ok;
+};
+
+void BgzfRange::inflate(const std::vector<BgzfBlock>* blocks, unsigned first,
+	unsigned last, const unsigned char* in, unsigned char* out)
+{
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+	if(inflateInit2(&z, -15)!=Z_OK) return;
+
+	ok=true;
+	for(unsigned k=first; k<last&&ok; ++k)
+	{
+		const BgzfBlock& b=(*blocks)[k];
+		inflateReset(&z);
+		z.next_in=(Bytef*)in+b.in;
+		z.avail_in=b.in_size;
+		z.next_out=out+b.out;
+		z.avail_out=b.out_size;
+		ok=::inflate(&z, Z_FINISH)==Z_STREAM_END&&z.avail_out==0
+			&&crc32(0, out+b.out, b.out_size)==b.crc;
+	}
+	inflateEnd(&z);
+}
+
+}
+
+LoadStats load_stats()
+{
+	Glib::Threads::Mutex::Lock lock(stats_mutex);
+	return stats_total;
+}
+
+void add_load_stats(LoadStats::Stage s, size_t bytes, double seconds)
+{
+	Glib::Threads::Mutex::Lock lock(stats_mutex);
+	stats_total.bytes[s]+=bytes;
+	stats_total.seconds[s]+=seconds;
+}
+
+//	A gzip file gives the size of its last member in its trailer, modulo 4GB,
+//	which is the size of the contents for the usual single member. BGZF files
+//	end with an empty block, their sizes are summed over the trailers of all
+//	blocks instead. The contents are taken to be at least as large as the
+//	file itself and at most as large as deflate can make them, which bounds
+//	the trailers of files that are cut off.
+unsigned long long contents_size(const std::string& f)
+{
+	if(f=="-") return 0;
+	int fd=open(f.c_str(), O_RDONLY);
+	if(fd<0) return 0;
+
+	struct stat info;
+	unsigned long long length=(fstat(fd, &info)==0&&info.st_size>0)?
+		info.st_size:0;
+	unsigned char p[18];
+	unsigned long long out=length;
+	if(length>=18&&pread(fd, p, 18, 0)==18&&p[0]==31&&p[1]==139)
+	{
+		unsigned long long at=0, sum=0;
+		bool bgzf=true;
+		while(bgzf&&at<length)
+		{
+			bgzf=pread(fd, p, 18, at)==18&&p[3]==4
+				&&little_endian(p+10, 2)==6&&p[12]=='B'&&p[13]=='C';
+			unsigned long long size=bgzf?little_endian(p+16, 2)+1:0;
+			bgzf=bgzf&&size>=26&&at+size<=length
+				&&pread(fd, p, 4, at+size-4)==4;
+			if(bgzf) sum+=little_endian(p, 4);
+			at+=size;
+		}
+		if(!bgzf&&pread(fd, p, 4, length-4)==4)
+			sum=std::min<unsigned long long>(little_endian(p, 4),
+				deflate_ratio*length);
+		out=std::max(sum, length);
+	}
+	close(fd);
+	return out;
+}
+
+MappedFile::MappedFile(const std::string& f)
+	:begin(NULL),length(0),mapping(NULL),ok(false)
+{
+	Glib::Timer timer;
+	int fd=(f=="-")?STDIN_FILENO:open(f.c_str(), O_RDONLY);
+	if(fd<0) return;
+
+	struct stat info;
+	if(fstat(fd, &info)==0&&S_ISREG(info.st_mode)&&info.st_size>0)
+	{
+		void* m=mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(m!=MAP_FAILED)
+		{
+			madvise(m, info.st_size, MADV_SEQUENTIAL);
+			mapping=m;
+			begin=(const char*)m;
+			length=info.st_size;
+		}
+	}
+	ok=(mapping!=NULL)||read(fd);
+
+	if(fd!=STDIN_FILENO) close(fd);
+	add_load_stats(LoadStats::read, length, timer.elapsed());
+
+	if(length<2||(unsigned char)begin[0]!=31||(unsigned char)begin[1]!=139)
+		return;
+
+	//	The compressed contents are replaced by the decompressed ones, or by
+	//	nothing if they are damaged or cut off.
+	timer.start();
+	std::vector<char> out;
+	ok=is_bgzf()?inflate_bgzf(out):inflate_gzip(out);
+	if(!ok) std::vector<char>().swap(out);
+
+	if(mapping!=NULL) munmap(mapping, length);
+	mapping=NULL;
+	buffer.swap(out);
+	begin=buffer.empty()?NULL:&buffer[0];
+	length=buffer.size();
+	add_load_stats(LoadStats::inflate, length, timer.elapsed());
+}
+
+MappedFile::~MappedFile()
+{
+	if(mapping!=NULL) munmap(mapping, length);
+}
+
+//	Other gzip files are inflated as a whole, even if they happen to begin
+//	with a block in the format of BGZF.
+bool MappedFile::is_bgzf() const
+{
+	std::vector<BgzfBlock> blocks;
+	return bgzf_blocks((const unsigned char*)begin, length, blocks);
+}
+
+//	The blocks are inflated straight into their place in the buffer, in
+//	ranges of consecutive blocks, one for each thread.
+bool MappedFile::inflate_bgzf(std::vector<char>& out) const
+{
+	const unsigned char* in=(const unsigned char*)begin;
+	std::vector<BgzfBlock> blocks;
+	if(!bgzf_blocks(in, length, blocks)) return false;
+
+	out.resize(blocks.back().out+blocks.back().out_size);
+	if(out.empty()) return true;
+	unsigned char* to=(unsigned char*)&out[0];
+
+	unsigned n=std::max<size_t>(1, std::min<size_t>(
+		Glib::get_num_processors(), length/inflate_thread_bytes));
+	n=std::min<size_t>(n, blocks.size());
+	std::vector<BgzfRange> ranges(n);
+	std::vector<Glib::Threads::Thread*> workers;
+	for(unsigned k=1; k<n; ++k)
+		workers.push_back(Glib::Threads::Thread::create(sigc::bind(
+			sigc::mem_fun(ranges[k], &BgzfRange::inflate), &blocks,
+			(unsigned)(blocks.size()*k/n), (unsigned)(blocks.size()*(k+1)/n),
+			in, to)));
+	ranges[0].inflate(&blocks, 0, blocks.size()/n, in, to);
+	for(unsigned k=0; k<workers.size(); ++k)
+		workers[k]->join();
+
+	for(unsigned k=0; k<n; ++k)
+		if(!ranges[k].ok) return false;
+	return true;
+}
+
+//	Inflates one gzip member after another into the buffer, which starts at
+//	the size that the trailer of the last member gives. That is exact for a
+//	single member below 4GB. Returns false if the data is damaged or ends
+//	within a member.
+bool MappedFile::inflate_gzip(std::vector<char>& out) const
+{
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+	if(inflateInit2(&z, 15+16)!=Z_OK) return false;
+
+	size_t hint=length>=4?
+		little_endian((const unsigned char*)begin+length-4, 4):0;
+	out.resize(std::max(hint, length)+1);
+	size_t used=0, consumed=0;
+	bool complete=false;
+	for(;;)
+	{
+		if(z.avail_in==0&&consumed<length)
+		{
+			z.next_in=(Bytef*)begin+consumed;
+			z.avail_in=std::min(length-consumed, inflate_step);
+			consumed+=z.avail_in;
+		}
+		if(used==out.size()) out.resize(2*out.size());
+		z.next_out=(Bytef*)&out[used];
+		z.avail_out=std::min(out.size()-used, inflate_step);
+
+		unsigned space=z.avail_out;
+		int result=inflate(&z, Z_NO_FLUSH);
+		used+=space-z.avail_out;
+
+		bool rest=z.avail_in>0||consumed<length;
+		if(result==Z_STREAM_END&&!rest) { complete=true; break; }
+		else if(result==Z_STREAM_END) inflateReset(&z);
+		else if(result==Z_BUF_ERROR&&!rest) break;
+		else if(result!=Z_OK&&result!=Z_BUF_ERROR) break;
+	}
+	inflateEnd(&z);
+	out.resize(used);
+	return complete;
+}
+
+//	Reads everything up to the end of the stream, doubling the buffer. Reads
+//	that a signal interrupts are repeated, any other error leaves the
+//	contents empty and returns false.
+bool MappedFile::read(int fd)
+{
+	buffer.resize(1<<20);
+	size_t used=0;
+	for(;;)
+	{
+		if(used==buffer.size()) buffer.resize(2*buffer.size());
+		ssize_t got=::read(fd, &buffer[used], buffer.size()-used);
+		if(got<0&&errno==EINTR) continue;
+		if(got<0) { std::vector<char>().swap(buffer); return false; }
+		if(got==0) break;
+		used+=got;
+	}
+	buffer.resize(used);
+	begin=buffer.empty()?NULL:&buffer[0];
+	length=used;
+	return true;
+}
+
+//	Splits the contents into at most n pieces of similar size, but not
+//	smaller than minimum bytes, that begin at the start of a line. The result
+//	holds the offset of every piece followed by the size of the contents.
+std::vector<size_t> MappedFile::split(unsigned n, size_t minimum) const
+{
+	n=std::max(1u, std::min<unsigned>(n, length/std::max<size_t>(minimum, 1)));
+
+	std::vector<size_t> out(1, 0);
+	for(unsigned k=1; k<n; ++k)
+	{
+		size_t at=std::max(out.back(), (size_t)((unsigned long long)length*k/n));
+		const char* newline=(const char*)memchr(begin+at, '\n', length-at);
+		if(newline==NULL) break;
+		if((size_t)(newline-begin)+1<length)
+			out.push_back(newline-begin+1);
+	}
+	out.push_back(length);
+	return out;
+}
+
+}
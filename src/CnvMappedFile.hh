@@ -0,0 +1,97 @@
+/*
+ *      CnvMappedFile.hh - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CNVMAPPEDFILE_
+#define _CNVMAPPEDFILE_
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/* This file gives the loaders the whole contents of a file as one block of
+   characters. Regular files are mapped into memory, so that they are parsed
+   straight from the page cache without being copied. The standard input,
+   pipes and everything else that cannot be mapped is read into a buffer
+   instead. The name "-" stands for the standard input. A file that cannot be
+   read completely yields no contents at all, never a part of them.
+
+   Files that begin with the gzip magic bytes are decompressed into a buffer
+   with zlib, as a whole, because the loaders split their input into pieces
+   for several threads. Damaged or cut off compressed files yield no
+   contents and are not good. BGZF files, which are gzip files made of small
+   independent blocks, are decompressed on one thread per processor, block
+   by block.
+   The time spent reading, decompressing and parsing is summed up for all
+   files and can be queried with load_stats. */
+
+namespace Cnv {
+
+//	Bytes and seconds spent in each stage of loading, summed over all files
+//	loaded so far. The bytes of the inflate stage are those that came out.
+struct LoadStats
+{
+	enum Stage { read, inflate, parse, stages };
+
+	unsigned long long bytes[stages];
+	double seconds[stages];
+};
+
+LoadStats load_stats();
+void add_load_stats(LoadStats::Stage s, size_t bytes, double seconds);
+
+//	The size of the contents a MappedFile would give for the file, read from
+//	the trailers of compressed files without decompressing them. It is 0 for
+//	the standard input and for files that cannot be opened.
+unsigned long long contents_size(const std::string& f);
+
+class MappedFile
+{
+public:
+
+	explicit MappedFile(const std::string& f);
+	~MappedFile();
+
+	const char* data() const { return begin; }
+	size_t size() const { return length; }
+
+	//	False if the file could not be opened or read to its end, the
+	//	contents are empty then.
+	bool good() const { return ok; }
+
+	std::vector<size_t> split(unsigned n, size_t minimum) const;
+
+private:
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	bool read(int fd);
+	bool is_bgzf() const;
+	bool inflate_bgzf(std::vector<char>& out) const;
+	bool inflate_gzip(std::vector<char>& out) const;
+
+	const char* begin;
+	size_t length;
+	void* mapping;
+	std::vector<char> buffer;
+	bool ok;
+};
+
+}
+
+#endif
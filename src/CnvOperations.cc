@@ -20,6 +20,10 @@
 #include "CnvOperations.hh"
 
 #include "CnvSequence.hh"
+#include "CnvKernels.hh"
+#include "CnvExpression.hh"
+#include "CnvReductions.hh"
+#include "CnvFourier.hh"
 
 #include <glibmm.h>
 #include <algorithm>
@@ -27,6 +31,8 @@
 #include <set>
 #include <fftw3.h>
 #include <cmath>
+#include <cstring>
+#include <climits>
 
 /* This file defines all the basic operations that can be performed on data
    sequences. Only the load and save routines are outsourced to the
@@ -37,17 +43,19 @@ namespace Cnv {
 
 Sequence add(const Sequence& s, float p)
 {
-	Sequence out; out.reserve(s.size());
+	Sequence out(s.get_manifest()); out.reserve(s.size());
 	for(SequenceSingleIterator iter(s); iter; ++iter)
-		out.push_back(iter.name(), iter.value()+p);
+		out.push_back(iter.name(), iter.value()+p,
+			iter.chromosome(), iter.position());
 	return out;
 }
 
 Sequence mul(const Sequence& s, float p)
 {
-	Sequence out; out.reserve(s.size());
+	Sequence out(s.get_manifest()); out.reserve(s.size());
 	for(SequenceSingleIterator iter(s); iter; ++iter)
-		out.push_back(iter.name(), iter.value()*p);
+		out.push_back(iter.name(), iter.value()*p,
+			iter.chromosome(), iter.position());
 	return out;
 }
 
@@ -58,74 +66,315 @@ Sequence div(const Sequence& s, float p)
 
 Sequence pow(const Sequence& s, float p)
 {
-	float f=cosf(M_PI*p);
-	Sequence out; out.reserve(s.size());
-	for(SequenceSingleIterator iter(s); iter; ++iter)
-		out.push_back(iter.name(),
-			::pow(fabs(iter.value()), p)*((iter.value()>=0)?1.0f:f));
+	Sequence out(s.get_manifest());
+	Kernel::pow(s.get_values().data(), out.extend(s.size()), s.size(), p);
 	return out;
 }
 
 Sequence root(const Sequence& s, float p)
 	{ return pow(s, 1.0f/p); }
 
-Sequence blur(const Sequence& s, float p)
+namespace {
+
+//	A range of data points that is blurred on its own, either a whole
+//	sequence or one chromosome of it. Its finite values are extended by
+//	reflection on both sides, by four standard deviations of the gaussian or
+//	as far as the values reach. For the Fourier engine, they are then padded
+//	to a length that FFTW transforms quickly.
+class BlurSegment
+{
+public:
+	BlurSegment(unsigned k, unsigned b, unsigned e, const Sequence& s,
+		float p, BlurEngine engine):sequence(k),begin(b),end(e)
+	{
+		const Sequence::Values values=s.get_values();
+		finite=0;
+		for(unsigned i=begin; i<end; i++)
+			if(!std::isnan(values[i])&&!std::isinf(values[i]))
+				finite++;
+
+		double deviation=std::fabs((double)p)/(2.0*M_PI);
+		margin=finite;
+		if(deviation*4.0<finite) margin=(unsigned)std::ceil(deviation*4.0);
+		padded=finite+2*margin;
+		if(finite>0&&engine==FourierBlur)
+			padded=Fourier::smooth_length(padded);
+	}
+
+	unsigned sequence;
+	unsigned begin;
+	unsigned end;
+	unsigned finite;
+	unsigned margin;
+	unsigned padded;
+};
+
+//	A batch of segments that share the same padded length and are
+//	transformed together by one plan. The results are written to the value
+//	arrays in out, which already hold the values that are not finite.
+class BlurJob
 {
-	static Glib::Threads::Mutex Mutex;
-	Mutex.lock();
+public:
+	const std::vector<const Sequence*>* in;
+	const std::vector<Sequence::value_type*>* out;
+	std::vector<BlurSegment> segments;
+	unsigned padded;
+	float p;
+	BlurEngine engine;
+};
+
+//	Multiplies the spectra of count consecutive rows of padded values with
+//	the gaussian.
+bool fourier_gaussian(double* Real, unsigned padded, unsigned count, float p)
+{
+	const unsigned complex_size=padded/2+1;
+	Fourier::ComplexBuffer Buffer((size_t)complex_size*count);
+	fftw_complex* Complex=Buffer.data();
+	if(Complex==NULL) return false;
 
-	Sequence out; out.reserve(s.size());
-	if(s.size()>0)
+	Fourier::Transform Plan(padded, count);
+	if(!Plan.valid()) return false;
+
+	Plan.forward(Real, Complex);
+
+	double MaxFreq=(double)padded/p;
+	for(unsigned i=0; i<complex_size; i++)
+	{
+		double Temp=(double)i*(double)i/(MaxFreq*MaxFreq)/2.0;
+		double Factor=::exp(-Temp)/(double)padded;
+		for(unsigned k=0; k<count; k++)
+		{
+			Complex[(size_t)k*complex_size+i][0]*=Factor;
+			Complex[(size_t)k*complex_size+i][1]*=Factor;
+		}
+	}
+
+	Plan.backward(Complex, Real);
+	return true;
+}
+
+//	The recursive gaussian filter of Young and van Vliet, a causal and an
+//	anticausal third order filter. Both passes start in the steady state of
+//	the value at their end of the row.
+void recursive_gaussian(double* x, unsigned n, double sigma)
+{
+	if(n==0||sigma<0.5) return;
+
+	double q=(sigma>=2.5)?0.98711*sigma-0.96330
+		:3.97156-4.14554*std::sqrt(1.0-0.26891*sigma);
+	double q2=q*q, q3=q2*q;
+	double b0=1.57825+2.44413*q+1.4281*q2+0.422205*q3;
+	double b1=(2.44413*q+2.85619*q2+1.26661*q3)/b0;
+	double b2=-(1.4281*q2+1.26661*q3)/b0;
+	double b3=0.422205*q3/b0;
+	double B=1.0-(b1+b2+b3);
+
+	double w1=x[0], w2=x[0], w3=x[0];
+	for(unsigned i=0; i<n; i++)
+	{
+		double w=B*x[i]+b1*w1+b2*w2+b3*w3;
+		x[i]=w; w3=w2; w2=w1; w1=w;
+	}
+
+	w1=w2=w3=x[n-1];
+	for(unsigned i=n; i-->0; )
 	{
-		double* Real=(double*)fftw_malloc(s.size()*sizeof(double));
-		fftw_complex* Complex=(fftw_complex*)
-			fftw_malloc((s.size()/2+1)*sizeof(fftw_complex));
+		double w=B*x[i]+b1*w1+b2*w2+b3*w3;
+		x[i]=w; w3=w2; w2=w1; w1=w;
+	}
+}
+
+//	Copies the finite values of a segment to the row of padded values after
+//	its margin and fills the rest of the row by reflection.
+void gather_segment(const BlurJob& job, const BlurSegment& segment,
+	double* row)
+{
+	const Sequence::Values values=
+		(*job.in)[segment.sequence]->get_values();
+	double* data=row+segment.margin;
+
+	unsigned counter=0;
+	for(unsigned i=segment.begin; i<segment.end; i++)
+		if(!std::isnan(values[i])&&!std::isinf(values[i]))
+			data[counter++]=values[i];
+	Fourier::reflect(data, segment.finite,
+		segment.margin, job.padded-segment.finite-segment.margin);
+}
+
+//	Writes the blurred values of the row back to the finite data points.
+void scatter_segment(const BlurJob& job, const BlurSegment& segment,
+	const double* row)
+{
+	const Sequence::Values values=
+		(*job.in)[segment.sequence]->get_values();
+	Sequence::value_type* blurred=(*job.out)[segment.sequence];
+	const double* data=row+segment.margin;
+
+	unsigned counter=0;
+	for(unsigned i=segment.begin; i<segment.end; i++)
+		if(!std::isnan(values[i])&&!std::isinf(values[i]))
+			blurred[i]=data[counter++];
+}
+
+//	The recursive filter runs on one row at a time in an array of its own, so
+//	that it takes nothing from the scratch pool of the transforms.
+bool blur_batch(const BlurJob& job)
+{
+	const unsigned padded=job.padded;
+	const unsigned count=job.segments.size();
 
-		if(Real!=NULL&&Complex!=NULL)
+	if(job.engine==RecursiveBlur)
+	{
+		std::vector<double> row(padded);
+		for(unsigned k=0; k<count; k++)
+		{
+			gather_segment(job, job.segments[k], &row[0]);
+			recursive_gaussian(&row[0], padded,
+				std::fabs((double)job.p)/(2.0*M_PI));
+			scatter_segment(job, job.segments[k], &row[0]);
+		}
+		return true;
+	}
+
+	Fourier::RealBuffer Buffer((size_t)padded*count);
+	double* Real=Buffer.data();
+	if(Real==NULL) return false;
+
+	for(unsigned k=0; k<count; k++)
+		gather_segment(job, job.segments[k], Real+(size_t)k*padded);
+	if(!fourier_gaussian(Real, padded, count, job.p)) return false;
+	for(unsigned k=0; k<count; k++)
+		scatter_segment(job, job.segments[k], Real+(size_t)k*padded);
+	return true;
+}
+
+//	Workers take the next job from the shared list until none is left, and
+//	note the sequences of the jobs that failed.
+class BlurQueue
+{
+public:
+	BlurQueue(const std::vector<BlurJob>& j):jobs(j),next(0) {}
+
+	void work()
+	{
+		for(;;)
 		{
-			unsigned newSize=0;
-			for(SequenceSingleIterator iter(s); iter; ++iter)
-				if(!std::isnan(iter.value())&&!std::isinf(iter.value()))
-					Real[newSize++]=iter.value();
-
-			fftw_plan Plan;
-			Plan=fftw_plan_dft_r2c_1d(newSize,
-				Real, Complex, FFTW_ESTIMATE);
-			fftw_execute(Plan);
-			fftw_destroy_plan(Plan);
-
-			double MaxFreq=(double)newSize/p;
-			for(unsigned i=0; i<newSize/2+1; i++)
+			mutex.lock();
+			unsigned k=next++;
+			mutex.unlock();
+			if(k>=jobs.size()) return;
+			if(!blur_batch(jobs[k]))
 			{
-				double Temp=(double)i*(double)i/(MaxFreq*MaxFreq)/2.0;
-				Complex[i][0]*=::exp(-Temp)/(double)newSize;
-				Complex[i][1]*=::exp(-Temp)/(double)newSize;
+				mutex.lock();
+				for(unsigned i=0; i<jobs[k].segments.size(); i++)
+					failed.insert(jobs[k].segments[i].sequence);
+				mutex.unlock();
 			}
+		}
+	}
+
+	std::set<unsigned> failed;
+
+private:
+	const std::vector<BlurJob>& jobs;
+	Glib::Threads::Mutex mutex;
+	unsigned next;
+};
+
+//	A batch holds at most this many doubles, 32MB, so that the scratch
+//	arrays of all workers stay small compared to the sequences themselves.
+const unsigned blur_batch_values=1<<22;
+
+//	Transformed values per thread below which starting another thread does
+//	not pay.
+const unsigned blur_thread_values=1<<16;
+
+}
+
+//	Multiplies the spectrum of the finite values with a Gaussian, or applies
+//	the recursive filter to them. The transforms run concurrently in all
+//	threads on arrays of their own.
+Sequence blur(const Sequence& s, float p, BlurEngine engine, BlurScope scope)
+{
+	std::vector<const Sequence*> batch(1, &s);
+	return blur(batch, p, engine, scope).front();
+}
+
+//	Blurs all sequences like the above. With ChromosomeScope, every run of
+//	data points on the same chromosome is blurred on its own. Segments of the
+//	same padded length, across all sequences, are transformed in batches by a
+//	single plan. The batches are distributed over one worker thread per
+//	processor, or fewer if there are too few values to transform.
+std::vector<Sequence> blur(const std::vector<const Sequence*>& s, float p,
+	BlurEngine engine, BlurScope scope)
+{
+	std::vector<Sequence> out(s.size());
+	std::vector<Sequence::value_type*> blurred(s.size());
+	std::map<unsigned,std::vector<BlurSegment> > groups;
+	for(unsigned k=0; k<s.size(); k++)
+	{
+		const Sequence::Values values=s[k]->get_values();
+		out[k]=Sequence(s[k]->get_manifest());
+		blurred[k]=out[k].extend(values.size());
+		std::copy(values.begin(), values.end(), blurred[k]);
+
+		for(unsigned begin=0, end=0; begin<values.size(); begin=end)
+		{
+			end=values.size();
+			if(scope==ChromosomeScope)
+				for(end=begin+1; end<values.size(); end++)
+					if(s[k]->chromosome(end)!=s[k]->chromosome(begin)) break;
 
-			Plan=fftw_plan_dft_c2r_1d(newSize,
-				Complex, Real, FFTW_ESTIMATE);
-			fftw_execute(Plan);
-			fftw_destroy_plan(Plan);
+			BlurSegment segment(k, begin, end, *s[k], p, engine);
+			if(segment.finite>0) groups[segment.padded].push_back(segment);
+		}
+	}
 
-			unsigned counter=0;
-			for(SequenceSingleIterator iter(s); iter; ++iter)
-				if(std::isnan(iter.value())||std::isinf(iter.value()))
-					out.push_back(iter.name(), iter.value());
-				else out.push_back(iter.name(), Real[counter++]);
+	unsigned long long values=0;
+	for(std::map<unsigned,std::vector<BlurSegment> >::const_iterator
+		it=groups.begin(); it!=groups.end(); ++it)
+		values+=(unsigned long long)it->first*it->second.size();
+	unsigned threads=std::max(1u, std::min(Glib::get_num_processors(),
+		(unsigned)std::min<unsigned long long>(values/blur_thread_values,
+		UINT_MAX)));
+
+	std::vector<BlurJob> jobs;
+	for(std::map<unsigned,std::vector<BlurSegment> >::const_iterator
+		it=groups.begin(); it!=groups.end(); ++it)
+	{
+		unsigned size=std::max(1u, blur_batch_values/it->first);
+		size=std::min(size, (unsigned)(it->second.size()+threads-1)/threads);
+		for(unsigned i=0; i<it->second.size(); i+=size)
+		{
+			BlurJob job;
+			job.in=&s; job.out=&blurred;
+			job.padded=it->first; job.p=p; job.engine=engine;
+			job.segments.assign(it->second.begin()+i, it->second.begin()
+				+std::min((size_t)i+size, it->second.size()));
+			jobs.push_back(job);
 		}
-		if(Complex!=NULL) fftw_free(Complex);
-		if(Real!=NULL) fftw_free(Real);
 	}
-	Mutex.unlock();
+
+	BlurQueue queue(jobs);
+	std::vector<Glib::Threads::Thread*> workers;
+	for(unsigned i=1; i<std::min(threads, (unsigned)jobs.size()); i++)
+		workers.push_back(Glib::Threads::Thread::create(
+			sigc::mem_fun(queue, &BlurQueue::work)));
+	queue.work();
+	for(unsigned i=0; i<workers.size(); i++)
+		workers[i]->join();
+
+	for(std::set<unsigned>::const_iterator it=queue.failed.begin();
+		it!=queue.failed.end(); ++it)
+		out[*it]=Sequence();
+
 	return out;
 }
 
 Sequence trunc(const Sequence& s, float p)
 {
-	Sequence out; out.reserve(s.size());
-	for(SequenceSingleIterator iter(s); iter; ++iter)
-		if(std::isnan(iter.value())) out.push_back(iter.name(), iter.value());
-		else out.push_back(iter.name(), std::min(std::max((float)iter.value(), -p), p));
+	Sequence out(s.get_manifest());
+	Kernel::trunc(s.get_values().data(), out.extend(s.size()), s.size(), p);
 	return out;
 }
 
@@ -134,94 +383,111 @@ Sequence cut(const Sequence& s, float p)
 	Sequence out; out.reserve(s.size());
 	for(SequenceSingleIterator iter(s); iter; ++iter)
 		if(!std::isnan(iter.value())&&iter.value()>=-p&&iter.value()<=p)
-			out.push_back(iter.name(), iter.value());
+			out.push_back(iter.name(), iter.value(),
+				iter.chromosome(), iter.position());
 	return out;
 }
 
 Sequence exp(const Sequence& s)
 {
-	Sequence out; out.reserve(s.size());
-	for(SequenceSingleIterator iter(s); iter; ++iter)
-		out.push_back(iter.name(), ::exp(iter.value()));
+	Sequence out(s.get_manifest());
+	Kernel::exp(s.get_values().data(), out.extend(s.size()), s.size());
 	return out;
 }
 
 Sequence log(const Sequence& s)
 {
-	Sequence out; out.reserve(s.size());
-	for(SequenceSingleIterator iter(s); iter; ++iter)
-		out.push_back(iter.name(), ::log(iter.value()));
+	Sequence out(s.get_manifest());
+	Kernel::log(s.get_values().data(), out.extend(s.size()), s.size());
 	return out;
 }
 
 Sequence abs(const Sequence& s)
 {
-	Sequence out; out.reserve(s.size());
-	for(SequenceSingleIterator iter(s); iter; ++iter)
-		out.push_back(iter.name(), ::fabs(iter.value()));
+	Sequence out(s.get_manifest());
+	Kernel::abs(s.get_values().data(), out.extend(s.size()), s.size());
 	return out;
 }
 
 Sequence erf(const Sequence& s)
 {
-	Sequence out; out.reserve(s.size());
-	for(SequenceSingleIterator iter(s); iter; ++iter)
-		out.push_back(iter.name(), ::erf(iter.value()));
+	Sequence out(s.get_manifest());
+	Kernel::erf(s.get_values().data(), out.extend(s.size()), s.size());
 	return out;
 }
 
-bool sort_names_compare(
-	const std::pair<StringPointer,float>& p1,
-	const std::pair<StringPointer,float>& p2)
-{
-	return p1.first<p2.first
-		||(p1.first==p2.first&&p1.second<p2.second);
-}
-
-bool sort_values_compare(
-	const std::pair<StringPointer,float>& p1,
-	const std::pair<StringPointer,float>& p2)
+class SortNamesCompare
 {
-	return p1.second<p2.second
-		||(p1.second==p2.second&&p1.first<p2.first);
-}
+public:
+	SortNamesCompare(const Sequence& s): seq(s) {}
 
-Sequence sort_names(const Sequence& s)
-{
-	std::vector<std::pair<StringPointer,float> > tmp;
+	bool operator()(unsigned i1, unsigned i2) const
+	{
+		StringPointer n1=(i1<seq.get_names().size())
+			?seq.get_names()[i1]:StringPointer();
+		StringPointer n2=(i2<seq.get_names().size())
+			?seq.get_names()[i2]:StringPointer();
+		float v1=seq.get_values()[i1], v2=seq.get_values()[i2];
+		int c=n1.compare(n2);
+		return c<0||(c==0&&v1<v2);
+	}
 
-	for(SequenceSingleIterator iter(s); iter; ++iter)
-		tmp.push_back(std::pair<StringPointer,float>(iter.name(), iter.value()));
+private:
+	const Sequence& seq;
+};
 
-	std::sort(tmp.begin(), tmp.end(), sort_names_compare);
+class SortValuesCompare
+{
+public:
+	SortValuesCompare(const Sequence& s): seq(s) {}
 
-	Sequence out; out.reserve(s.size());
+	bool operator()(unsigned i1, unsigned i2) const
+	{
+		StringPointer n1=(i1<seq.get_names().size())
+			?seq.get_names()[i1]:StringPointer();
+		StringPointer n2=(i2<seq.get_names().size())
+			?seq.get_names()[i2]:StringPointer();
+		float v1=seq.get_values()[i1], v2=seq.get_values()[i2];
+		return v1<v2||(v1==v2&&n1.compare(n2)<0);
+	}
 
-	std::vector<std::pair<StringPointer,float> >::const_iterator it;
+private:
+	const Sequence& seq;
+};
 
-	for(it=tmp.begin(); it!=tmp.end(); ++it)
-		out.push_back(it->first, it->second);
+Sequence permute(const Sequence& s, const std::vector<unsigned>& order)
+{
+	Sequence out; out.reserve(order.size());
 
+	std::vector<unsigned>::const_iterator it;
+	for(it=order.begin(); it!=order.end(); ++it)
+	{
+		if(*it<s.get_names().size())
+			out.push_back(s.get_names()[*it], s.get_values()[*it],
+				s.chromosome(*it), s.position(*it));
+		else out.push_back(s.get_values()[*it]);
+	}
 	return out;
 }
 
-Sequence sort_values(const Sequence& s)
+Sequence sort_names(const Sequence& s)
 {
-	std::vector<std::pair<StringPointer,float> > tmp;
-
-	for(SequenceSingleIterator iter(s); iter; ++iter)
-		tmp.push_back(std::pair<StringPointer,float>(iter.name(), iter.value()));
+	std::vector<unsigned> order(s.size());
+	for(unsigned i=0; i<order.size(); ++i) order[i]=i;
 
-	std::sort(tmp.begin(), tmp.end(), sort_values_compare);
+	std::sort(order.begin(), order.end(), SortNamesCompare(s));
 
-	Sequence out; out.reserve(s.size());
+	return permute(s, order);
+}
 
-	std::vector<std::pair<StringPointer,float> >::const_iterator it;
+Sequence sort_values(const Sequence& s)
+{
+	std::vector<unsigned> order(s.size());
+	for(unsigned i=0; i<order.size(); ++i) order[i]=i;
 
-	for(it=tmp.begin(); it!=tmp.end(); ++it)
-		out.push_back(it->first, it->second);
+	std::sort(order.begin(), order.end(), SortValuesCompare(s));
 
-	return out;
+	return permute(s, order);
 }
 
 Sequence avg(const Sequence& s)
@@ -235,10 +501,12 @@ Sequence avg(const Sequence& s)
 	if(nanValues<s.size())
 		value/=(double)(s.size()-nanValues);
 
-	Sequence out; out.reserve(s.size());
+	Sequence out(s.get_manifest()); out.reserve(s.size());
 	for(SequenceSingleIterator iter(s); iter; ++iter)
-		if(std::isnan(iter.value())) out.push_back(iter.name(), iter.value());
-		else out.push_back(iter.name(), value);
+		if(std::isnan(iter.value())) out.push_back(iter.name(), iter.value(),
+			iter.chromosome(), iter.position());
+		else out.push_back(iter.name(), value,
+			iter.chromosome(), iter.position());
 
 	return out;
 }
@@ -261,191 +529,381 @@ Sequence rank(const Sequence& s)
 		current_value+=(float)jt->second/(float)s.size();
 	}
 
-	Sequence out;
+	Sequence out(s.get_manifest()); out.reserve(s.size());
 	for(SequenceSingleIterator iter(s); iter; ++iter)
-		out.push_back(iter.name(), tmp2[iter.value()]);
+		out.push_back(iter.name(), tmp2[iter.value()],
+			iter.chromosome(), iter.position());
 
 	return out;
 }
 
+namespace {
+
+//	True if the chromosome in the name "id/chr/pos" is one or two digits.
+//	These are the labels stripXY keeps, including zero padded ones like "01"
+//	that are not decoded to a chromosome number.
+bool numeric_chromosome(const char* name)
+{
+	const char* chr=strchr(name, '/');
+	if(chr==NULL||chr[1]<'0'||chr[1]>'9') return false;
+	return chr[2]=='/'||(chr[2]>='0'&&chr[2]<='9'&&chr[3]=='/');
+}
+
+}
+
 Sequence stripXY(const Sequence& s)
 {
 	Sequence out;
 	for(SequenceSingleIterator iter(s); iter; ++iter)
-	{
-		std::string s=iter.name();
-		size_t Finding=s.find('/');
-		if(Finding+2<s.size()&&(s[Finding+2]=='/'
-			||(s[Finding+2]>='0'&&s[Finding+2]<='9'&&s[Finding+3]=='/'))
-			&&s[Finding+1]>='0'&&s[Finding+1]<='9')
-			out.push_back(iter.name(), iter.value());
-	}
+		if(iter.chromosome()<100||(iter.chromosome()==UCHAR_MAX
+			&&numeric_chromosome(iter.name().c_str())))
+			out.push_back(iter.name(), iter.value(),
+				iter.chromosome(), iter.position());
 	return out;
 }
 
 Sequence add(const Sequence& s, const Sequence& t)
 {
-	Sequence out;
-	for(SequenceDualIterator iter(s, t); iter; ++iter)
-		out.push_back(iter.name(), iter.first()+iter.second());
+	AlignmentPlan p;
+	return add(s, t, p);
+}
+
+Sequence add(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+{
+	SequenceDualIterator iter(s, t, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
+		out.push_back(iter.name(), iter.first()+iter.second(),
+			iter.chromosome(), iter.position());
 	return out;
 }
 
 Sequence mul(const Sequence& s, const Sequence& t)
 {
-	Sequence out;
-	for(SequenceDualIterator iter(s, t); iter; ++iter)
-		out.push_back(iter.name(), iter.first()*iter.second());
+	AlignmentPlan p;
+	return mul(s, t, p);
+}
+
+Sequence mul(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+{
+	SequenceDualIterator iter(s, t, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
+		out.push_back(iter.name(), iter.first()*iter.second(),
+			iter.chromosome(), iter.position());
 	return out;
 }
 
 Sequence sub(const Sequence& s, const Sequence& t)
 {
-	Sequence out;
-	for(SequenceDualIterator iter(s, t); iter; ++iter)
-		out.push_back(iter.name(), iter.first()-iter.second());
+	AlignmentPlan p;
+	return sub(s, t, p);
+}
+
+Sequence sub(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+{
+	SequenceDualIterator iter(s, t, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
+		out.push_back(iter.name(), iter.first()-iter.second(),
+			iter.chromosome(), iter.position());
 	return out;
 }
 
 Sequence div(const Sequence& s, const Sequence& t)
 {
-	Sequence out;
-	for(SequenceDualIterator iter(s, t); iter; ++iter)
-		out.push_back(iter.name(), iter.first()/iter.second());
+	AlignmentPlan p;
+	return div(s, t, p);
+}
+
+Sequence div(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+{
+	SequenceDualIterator iter(s, t, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
+		out.push_back(iter.name(), iter.first()/iter.second(),
+			iter.chromosome(), iter.position());
 	return out;
 }
 
 Sequence sort(const Sequence& s, const Sequence& t)
 {
-	std::map<std::string,float> temp;
+	std::map<StringPointer,float> temp;
 	for(SequenceSingleIterator iter(s); iter; ++iter)
 		temp[iter.name()]=iter.value();
 
-	Sequence out;
+	Sequence out(t.get_manifest()); out.reserve(t.size());
 	for(SequenceSingleIterator iter(t); iter; ++iter)
-		out.push_back(iter.name(), temp[iter.name()]);
+		out.push_back(iter.name(), temp[iter.name()],
+			iter.chromosome(), iter.position());
 
 	return out;
 }
 
+//	Removes the part of s that is proportional to t, with the factor of the
+//	least squares fit of s by t.
+//	Subtracts t scaled by avg(s*t)/avg(t*t). The mean product is taken over
+//	the aligned data points, the mean square over all of t.
+Sequence eliminate(const Sequence& s, const Sequence& t)
+{
+	AlignmentPlan p;
+	float factor=mean_product(s, t, p)/mean_square(t);
+	return (lazy(s)-lazy(t)*factor).evaluate(p);
+}
+
 Sequence add(const std::vector<const Sequence*>& s)
 {
-	Sequence out;
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	AlignmentPlan p;
+	return add(s, p);
+}
+
+Sequence add(const std::vector<const Sequence*>& s, AlignmentPlan& p)
+{
+	SequenceMultiIterator iter(s, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
 	{
 		float value=0.0;
 		for(unsigned i=0; i<s.size(); ++i) value+=iter[i];
-		out.push_back(iter.name(), value);
+		out.push_back(iter.name(), value,
+			iter.chromosome(), iter.position());
 	}
 	return out;
 }
 
 Sequence arithmetic(const std::vector<const Sequence*>& s)
 {
-	Sequence out;
+	AlignmentPlan p;
+	return arithmetic(s, p);
+}
+
+Sequence arithmetic(const std::vector<const Sequence*>& s, AlignmentPlan& p)
+{
+	SequenceMultiIterator iter(s, p);
+	Sequence out(p.manifest());
 	float divisor=(s.size()!=0)?((float)s.size()):1.0;
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	for(; iter; ++iter)
 	{
 		float value=0.0;
 		for(unsigned i=0; i<s.size(); ++i) value+=iter[i];
-		out.push_back(iter.name(), value/divisor);
+		out.push_back(iter.name(), value/divisor,
+			iter.chromosome(), iter.position());
 	}
 	return out;
 }
 
 Sequence mul(const std::vector<const Sequence*>& s)
 {
-	Sequence out;
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	AlignmentPlan p;
+	return mul(s, p);
+}
+
+Sequence mul(const std::vector<const Sequence*>& s, AlignmentPlan& p)
+{
+	SequenceMultiIterator iter(s, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
 	{
 		float value=1.0;
 		for(unsigned i=0; i<s.size(); ++i) value*=iter[i];
-		out.push_back(iter.name(), value);
+		out.push_back(iter.name(), value,
+			iter.chromosome(), iter.position());
 	}
 	return out;
 }
 
 Sequence geometric(const std::vector<const Sequence*>& s)
 {
-	Sequence out;
+	AlignmentPlan p;
+	return geometric(s, p);
+}
+
+Sequence geometric(const std::vector<const Sequence*>& s, AlignmentPlan& p)
+{
+	SequenceMultiIterator iter(s, p);
+	Sequence out(p.manifest());
 	float divisor=(s.size()!=0)?((float)s.size()):1.0;
 	float factor=::cos(M_PI/divisor);
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	for(; iter; ++iter)
 	{
 		float value=1.0;
 		for(unsigned i=0; i<s.size(); ++i) value*=iter[i];
 		out.push_back(iter.name(), ::pow(::fabs(value), 1.0/divisor)
-			*((value>=0.0)?1.0:factor));
+			*((value>=0.0)?1.0:factor), iter.chromosome(), iter.position());
 	}
 	return out;
 }
 
 Sequence min(const std::vector<const Sequence*>& s)
 {
-	Sequence out;
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	AlignmentPlan p;
+	return min(s, p);
+}
+
+Sequence min(const std::vector<const Sequence*>& s, AlignmentPlan& p)
+{
+	SequenceMultiIterator iter(s, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
 	{
 		float value=(s.size()>0)?iter[0]:0.0;
 		for(unsigned i=1; i<s.size(); ++i)
 			if(iter[i]<value) value=iter[i];
-		out.push_back(iter.name(), value);
+		out.push_back(iter.name(), value,
+			iter.chromosome(), iter.position());
 	}
 	return out;
 }
 
 Sequence max(const std::vector<const Sequence*>& s)
 {
-	Sequence out;
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	AlignmentPlan p;
+	return max(s, p);
+}
+
+Sequence max(const std::vector<const Sequence*>& s, AlignmentPlan& p)
+{
+	SequenceMultiIterator iter(s, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
 	{
 		float value=(s.size()>0)?iter[0]:0.0;
 		for(unsigned i=1; i<s.size(); ++i)
 			if(iter[i]>value) value=iter[i];
-		out.push_back(iter.name(), value);
+		out.push_back(iter.name(), value,
+			iter.chromosome(), iter.position());
 	}
 	return out;
 }
 
 Sequence median(const std::vector<const Sequence*>& s)
 {
-	Sequence out;
-	std::vector<float> buffer; buffer.resize(s.size());
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	AlignmentPlan p;
+	return median(s, p);
+}
+
+namespace {
+
+//	Computes the medians of the aligned data points first to last. Blocks of
+//	data points are gathered from the value columns of all sequences, which
+//	are each read in order, and then reduced point by point.
+class MedianTask
+{
+public:
+	void run()
 	{
-		for(unsigned i=0; i<s.size(); ++i) buffer[i]=iter[i];
-
-		std::sort(buffer.begin(), buffer.end());
-		if(buffer.size()>0&&buffer.size()%2==0)
-			out.push_back(iter.name(), (buffer[(buffer.size()-1)/2]
-				+buffer[buffer.size()/2])/2.0);
-		else if(buffer.size()>0&&buffer.size()%2==1)
-			out.push_back(iter.name(), buffer[buffer.size()/2]);
-		else out.push_back(iter.name(), 0.0);
+		const unsigned k=seqs->size();
+		const unsigned block=std::max(1u, median_block_values/std::max(1u, k));
+		std::vector<float> buffer((size_t)block*k);
+		for(unsigned b=first; b<last; b+=block)
+		{
+			unsigned e=std::min(last, b+block);
+			for(unsigned j=0; j<k; ++j)
+			{
+				const float* column=(*seqs)[j]->get_values().data();
+				for(unsigned i=b; i<e; ++i)
+					buffer[(size_t)(i-b)*k+j]=column[plan->index(i, j)];
+			}
+			for(unsigned i=b; i<e; ++i)
+				out[i]=Kernel::median(&buffer[(size_t)(i-b)*k], k);
+		}
 	}
+
+	//	A block holds at most this many values, 256kB, so that it stays in
+	//	the cache between gathering and reduction.
+	static const unsigned median_block_values=1<<16;
+
+	const std::vector<const Sequence*>* seqs;
+	const AlignmentPlan* plan;
+	float* out;
+	unsigned first;
+	unsigned last;
+};
+
+//	Data points per thread below which starting another thread does not pay.
+const unsigned median_thread_points=1<<14;
+
+}
+
+//	The data points are split evenly over one thread per processor.
+Sequence median(const std::vector<const Sequence*>& s, AlignmentPlan& p)
+{
+	if(!p.fits(s)) p=AlignmentPlan(s);
+
+	std::vector<float> medians(p.size());
+	unsigned threads=std::min(Glib::get_num_processors(),
+		p.size()/median_thread_points);
+	threads=std::max(1u, threads);
+
+	std::vector<MedianTask> tasks(threads);
+	for(unsigned t=0; t<threads; ++t)
+	{
+		tasks[t].seqs=&s; tasks[t].plan=&p; tasks[t].out=medians.data();
+		tasks[t].first=(unsigned)((unsigned long long)p.size()*t/threads);
+		tasks[t].last=(unsigned)((unsigned long long)p.size()*(t+1)/threads);
+	}
+
+	std::vector<Glib::Threads::Thread*> workers;
+	for(unsigned t=1; t<threads; ++t)
+		workers.push_back(Glib::Threads::Thread::create(
+			sigc::mem_fun(tasks[t], &MedianTask::run)));
+	tasks[0].run();
+	for(unsigned t=0; t<workers.size(); ++t)
+		workers[t]->join();
+
+	Sequence::ManifestPointer manifest=p.manifest();
+	if(manifest)
+	{
+		Sequence out(manifest);
+		std::copy(medians.begin(), medians.end(), out.extend(medians.size()));
+		return out;
+	}
+
+	Sequence out; out.reserve(medians.size());
+	unsigned i=0;
+	for(SequenceMultiIterator iter(s, p); iter; ++iter, ++i)
+		out.push_back(iter.name(), medians[i],
+			iter.chromosome(), iter.position());
 	return out;
 }
 
 Sequence deviation(const std::vector<const Sequence*>& s)
 {
-	Sequence out;
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	AlignmentPlan p;
+	return deviation(s, p);
+}
+
+Sequence deviation(const std::vector<const Sequence*>& s, AlignmentPlan& p)
+{
+	SequenceMultiIterator iter(s, p);
+	Sequence out(p.manifest());
+	for(; iter; ++iter)
 	{
 		float value=0.0;
 		for(unsigned i=0; i<s.size(); ++i) value+=iter[i]*iter[i];
-		out.push_back(iter.name(), ::sqrt(value));
+		out.push_back(iter.name(), ::sqrt(value),
+			iter.chromosome(), iter.position());
 	}
 	return out;
 }
 
 std::vector<Sequence> align(const std::vector<const Sequence*>& s)
 {
-	std::vector<Sequence> out;
-	out.resize(s.size());
-	for(SequenceMultiIterator iter(s); iter; ++iter)
+	AlignmentPlan p;
+	return align(s, p);
+}
+
+std::vector<Sequence> align(const std::vector<const Sequence*>& s,
+	AlignmentPlan& p)
+{
+	SequenceMultiIterator iter(s, p);
+	std::vector<Sequence> out(s.size(), Sequence(p.manifest()));
+	for(; iter; ++iter)
 	{
 		std::vector<Sequence>::iterator it=out.begin();
 		for(unsigned i=0; i<s.size(); ++i)
-			(it++)->push_back(iter.name(), iter[i]);
+			(it++)->push_back(iter.name(), iter[i],
+				iter.chromosome(), iter.position());
 	}
 	return out;
 }
@@ -28,13 +28,25 @@
 
 namespace Cnv {
 
+//	The engines of blur. FourierBlur multiplies the spectrum with a gaussian.
+//	RecursiveBlur applies the recursive filter of Young and van Vliet in
+//	linear time instead. Its results differ from those of FourierBlur by up
+//	to 2% of the range of the values, most around steps and for small p.
+enum BlurEngine { FourierBlur, RecursiveBlur };
+
+//	The ranges blur works on. GenomeScope blurs each sequence as a whole,
+//	ChromosomeScope blurs each chromosome on its own, so that values do not
+//	bleed into the neighbouring chromosomes.
+enum BlurScope { GenomeScope, ChromosomeScope };
+
 Sequence	add		(const Sequence&, float);
 Sequence	mul		(const Sequence&, float);
 Sequence	sub		(const Sequence&, float);
 Sequence	div		(const Sequence&, float);
 Sequence	pow		(const Sequence&, float);
 Sequence	root	(const Sequence&, float);
-Sequence	blur	(const Sequence&, float);
+Sequence	blur	(const Sequence&, float, BlurEngine=FourierBlur,
+	BlurScope=GenomeScope);
 Sequence	trunc	(const Sequence&, float);
 Sequence	cut		(const Sequence&, float);
 Sequence	exp			(const Sequence&);
@@ -51,6 +63,7 @@ Sequence	mul			(const Sequence&, const Sequence&);
 Sequence	sub			(const Sequence&, const Sequence&);
 Sequence	div			(const Sequence&, const Sequence&);
 Sequence 	sort		(const Sequence&, const Sequence&);
+Sequence	eliminate	(const Sequence&, const Sequence&);
 Sequence	add			(const std::vector<const Sequence*>&);
 Sequence	arithmetic	(const std::vector<const Sequence*>&);
 Sequence	mul			(const std::vector<const Sequence*>&);
@@ -60,6 +73,26 @@ Sequence	max			(const std::vector<const Sequence*>&);
 Sequence	median		(const std::vector<const Sequence*>&);
 Sequence	deviation	(const std::vector<const Sequence*>&);
 std::vector<Sequence>	align	(const std::vector<const Sequence*>&);
+std::vector<Sequence>	blur	(const std::vector<const Sequence*>&, float,
+	BlurEngine=FourierBlur, BlurScope=GenomeScope);
+
+//	The following variants reuse the alignment plan passed as last argument
+//	if it fits the sequences, or store a new one in it otherwise. Repeated
+//	operations over the same sequences are thus aligned only once.
+Sequence	add			(const Sequence&, const Sequence&, AlignmentPlan&);
+Sequence	mul			(const Sequence&, const Sequence&, AlignmentPlan&);
+Sequence	sub			(const Sequence&, const Sequence&, AlignmentPlan&);
+Sequence	div			(const Sequence&, const Sequence&, AlignmentPlan&);
+Sequence	add			(const std::vector<const Sequence*>&, AlignmentPlan&);
+Sequence	arithmetic	(const std::vector<const Sequence*>&, AlignmentPlan&);
+Sequence	mul			(const std::vector<const Sequence*>&, AlignmentPlan&);
+Sequence	geometric	(const std::vector<const Sequence*>&, AlignmentPlan&);
+Sequence	min			(const std::vector<const Sequence*>&, AlignmentPlan&);
+Sequence	max			(const std::vector<const Sequence*>&, AlignmentPlan&);
+Sequence	median		(const std::vector<const Sequence*>&, AlignmentPlan&);
+Sequence	deviation	(const std::vector<const Sequence*>&, AlignmentPlan&);
+std::vector<Sequence>	align	(const std::vector<const Sequence*>&,
+	AlignmentPlan&);
 
 inline Sequence operator+(const Sequence& a, float p)
 	{ return add(a, p); }
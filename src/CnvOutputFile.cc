@@ -0,0 +1,174 @@
+/*
+ *      CnvOutputFile.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvOutputFile.hh"
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/* This file writes files through one large buffer that is handed to the
+   operating system whenever it is full, so that the save routines can
+   format their fields straight into it. Files whose name ends in ".gz" are
+   compressed with zlib on a writer thread, while the next buffer is filled.
+   The name "-" stands for the standard output. */
+
+namespace Cnv {
+
+namespace {
+
+const size_t output_buffer_bytes=1<<20;
+
+void write_all(int fd, const char* s, size_t n)
+{
+	while(n>0)
+	{
+		ssize_t done=::write(fd, s, n);
+		if(done<=0) return;
+		s+=done;
+		n-=done;
+	}
+}
+
+}
+
+//	A gzip stream that writes its compressed output to a file descriptor.
+class OutputFile::Deflater
+{
+public:
+
+	Deflater(int f):fd(f),out(1<<18)
+	{
+		memset(&stream, 0, sizeof(stream));
+		deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8,
+			Z_DEFAULT_STRATEGY);
+	}
+	~Deflater() { deflateEnd(&stream); }
+
+	void deflate(const char* s, size_t n, int flush)
+	{
+		stream.next_in=(Bytef*)s;
+		stream.avail_in=n;
+		int result;
+		do
+		{
+			stream.next_out=(Bytef*)&out[0];
+			stream.avail_out=out.size();
+			result=::deflate(&stream, flush);
+			write_all(fd, &out[0], out.size()-stream.avail_out);
+		}
+		while(result==Z_OK&&(stream.avail_out==0||flush==Z_FINISH));
+	}
+
+private:
+
+	int fd;
+	z_stream stream;
+	std::vector<char> out;
+};
+
+OutputFile::OutputFile(const std::string& f)
+	:buffer(output_buffer_bytes),used(0),deflater(NULL),writer(NULL),
+	pending_used(0),closing(false)
+{
+	fd=(f=="-")?STDOUT_FILENO:open(f.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0666);
+
+	if(fd>=0&&f.size()>3&&f.compare(f.size()-3, 3, ".gz")==0)
+	{
+		deflater=new Deflater(fd);
+		pending.resize(output_buffer_bytes);
+		writer=Glib::Threads::Thread::create(
+			sigc::mem_fun(*this, &OutputFile::compress));
+	}
+}
+
+OutputFile::~OutputFile()
+{
+	flush();
+	if(writer!=NULL)
+	{
+		mutex.lock();
+		closing=true;
+		cond.broadcast();
+		mutex.unlock();
+		writer->join();
+		delete deflater;
+	}
+	if(fd>=0&&fd!=STDOUT_FILENO) close(fd);
+}
+
+void OutputFile::write(const char* s, size_t n)
+{
+	while(n>0)
+	{
+		if(used==buffer.size()) flush();
+		size_t part=std::min(n, buffer.size()-used);
+		memcpy(&buffer[used], s, part);
+		used+=part;
+		s+=part;
+		n-=part;
+	}
+}
+
+//	Without compression the buffer is written right away. Otherwise it is
+//	swapped with the one the writer thread has finished with.
+void OutputFile::flush()
+{
+	if(writer==NULL)
+	{
+		if(fd>=0) write_all(fd, &buffer[0], used);
+		used=0;
+		return;
+	}
+
+	mutex.lock();
+	while(pending_used>0) cond.wait(mutex);
+	buffer.swap(pending);
+	pending_used=used;
+	used=0;
+	cond.broadcast();
+	mutex.unlock();
+}
+
+//	Runs on the writer thread until the file is closed.
+void OutputFile::compress()
+{
+	mutex.lock();
+	for(;;)
+	{
+		while(pending_used==0&&!closing) cond.wait(mutex);
+		if(pending_used==0) break;
+
+		size_t n=pending_used;
+		mutex.unlock();
+		deflater->deflate(&pending[0], n, Z_NO_FLUSH);
+		mutex.lock();
+
+		pending_used=0;
+		cond.broadcast();
+	}
+	mutex.unlock();
+	deflater->deflate(NULL, 0, Z_FINISH);
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+ *      CnvOutputFile.hh - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CNVOUTPUTFILE_
+#define _CNVOUTPUTFILE_
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <glibmm.h>
+
+/* This file writes files through one large buffer that is handed to the
+   operating system whenever it is full, so that the save routines can
+   format their fields straight into it. Files whose name ends in ".gz" are
+   compressed with zlib on a writer thread, while the next buffer is filled.
+   The name "-" stands for the standard output. */
+
+namespace Cnv {
+
+class OutputFile
+{
+public:
+
+	explicit OutputFile(const std::string& f);
+	~OutputFile();
+
+	//	Makes room for at least n characters and returns where they go. n
+	//	must not exceed the size of the buffer.
+	char* reserve(size_t n)
+	{
+		if(used+n>buffer.size()) flush();
+		return &buffer[used];
+	}
+
+	//	Marks everything up to end, which points into the room that reserve
+	//	returned, as written.
+	void commit(const char* end) { used=end-&buffer[0]; }
+
+	void write(const char* s, size_t n);
+	void write(const std::string& s) { write(s.data(), s.size()); }
+
+private:
+
+	OutputFile(const OutputFile&);
+	OutputFile& operator=(const OutputFile&);
+
+	class Deflater;
+
+	void flush();
+	void compress();
+
+	int fd;
+	std::vector<char> buffer;
+	size_t used;
+
+	Deflater* deflater;
+	Glib::Threads::Thread* writer;
+	Glib::Threads::Mutex mutex;
+	Glib::Threads::Cond cond;
+	std::vector<char> pending;
+	size_t pending_used;
+	bool closing;
+};
+
+}
+
+#endif
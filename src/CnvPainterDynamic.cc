@@ -36,9 +36,9 @@ namespace Cnv {
 
 PainterDynamic::PainterDynamic() {}
 
-PainterDynamic::PainterDynamic(const vector<float>& s)
+PainterDynamic::PainterDynamic(const Sequence::Values& s)
 {
-	vector<float>::const_iterator it;
+	Sequence::Values::const_iterator it;
 	for(it=s.begin(); it!=s.end(); ++it)
 	{
 		if(isnan(*it)) points.push_back(255);
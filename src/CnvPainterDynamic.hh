@@ -20,6 +20,7 @@
 #ifndef _CNVPAINTERDYNAMIC_
 #define _CNVPAINTERDYNAMIC_
 #include "CnvPainterCore.hh"
+#include "CnvSequence.hh"
 
 #include <gtkmm.h>
 #include <vector>
@@ -38,7 +39,7 @@ class PainterDynamic: private PainterCore
 public:
 
 	PainterDynamic();
-	PainterDynamic(const vector<float>& s);
+	PainterDynamic(const Sequence::Values& s);
 
 	unsigned size() const;
 
@@ -28,7 +28,7 @@
 
 namespace Cnv {
 
-PainterStatic::PainterStatic(const std::vector<float>& s,
+PainterStatic::PainterStatic(const Sequence::Values& s,
 	unsigned width, unsigned height)
 {
 	if(width>0&&height>0&&s.size()>0)
@@ -42,7 +42,7 @@ PainterStatic::PainterStatic(const std::vector<float>& s,
 		std::vector<unsigned> pixels;
 		pixels.resize((unsigned)width*(unsigned)height);
 
-		std::vector<float>::const_iterator it;
+		Sequence::Values::const_iterator it;
 		for(it=s.begin(); it!=s.end(); ++it)
 		{
 			unsigned column=(it-s.begin())/points_per_pixel;
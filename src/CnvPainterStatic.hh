@@ -20,6 +20,7 @@
 #ifndef _VPAINTERSTATIC_
 #define _VPAINTERSTATIC_
 #include "CnvPainterCore.hh"
+#include "CnvSequence.hh"
 
 #include <gtkmm.h>
 
@@ -33,7 +34,7 @@ class PainterStatic: private PainterCore
 {
 public:
 	PainterStatic() {};
-	PainterStatic(const std::vector<float>& s, unsigned width, unsigned height);
+	PainterStatic(const Sequence::Values& s, unsigned width, unsigned height);
 	void draw(Cairo::RefPtr<Cairo::Context> cr,
 		unsigned width, unsigned height) const;
 private:
@@ -0,0 +1,191 @@
+/*
+ *      CnvReductions.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvReductions.hh"
+
+#include <cmath>
+
+/* This file defines reductions of data sequences to single numbers. They
+   accumulate in double precision over one or two aligned sequences and skip
+   NaN values like Cnv::avg does. mean_square, mean_product and slope take
+   the second moments about zero, as the filter and the eliminate macro do
+   with their centered sequences. slope is the factor of a least squares fit
+   of the first sequence by the second through the origin. variance,
+   covariance and correlation take them about the means, in a second pass.
+   Those of two sequences use only the aligned data points where neither
+   value is NaN. All of them divide by the number of values, not by one
+   less. */
+
+namespace Cnv {
+
+namespace {
+
+//	Sums of the products of aligned values with the number of products that
+//	are not NaN. The mean square of the second sequence is taken over the
+//	aligned data points as well.
+class Moments
+{
+public:
+	Moments(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+		:xy(0.0),yy(0.0),count_xy(0),count_yy(0)
+	{
+		for(SequenceDualIterator iter(s, t, p); iter; ++iter)
+		{
+			double x=iter.first(), y=iter.second();
+			if(!std::isnan(x*y)) { xy+=x*y; ++count_xy; }
+			if(!std::isnan(y)) { yy+=y*y; ++count_yy; }
+		}
+	}
+
+	double mean_product() const { return average(xy, count_xy); }
+	double second_mean_square() const { return average(yy, count_yy); }
+
+private:
+	static double average(double sum, unsigned count)
+		{ return (count!=0)?sum/(double)count:0.0; }
+
+	double xy, yy;
+	unsigned count_xy, count_yy;
+};
+
+//	Sums of the products and squares of the deviations from the means, over
+//	the aligned data points where neither value is NaN. The means are taken
+//	over the same data points in a first pass.
+class CentralMoments
+{
+public:
+	CentralMoments(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+		:xy(0.0),xx(0.0),yy(0.0),count(0)
+	{
+		double sum_x=0.0, sum_y=0.0;
+		for(SequenceDualIterator iter(s, t, p); iter; ++iter)
+		{
+			double x=iter.first(), y=iter.second();
+			if(!std::isnan(x)&&!std::isnan(y))
+				{ sum_x+=x; sum_y+=y; ++count; }
+		}
+		if(count==0) return;
+
+		double mean_x=sum_x/(double)count, mean_y=sum_y/(double)count;
+		for(SequenceDualIterator iter(s, t, p); iter; ++iter)
+		{
+			double x=iter.first(), y=iter.second();
+			if(!std::isnan(x)&&!std::isnan(y))
+			{
+				x-=mean_x; y-=mean_y;
+				xy+=x*y; xx+=x*x; yy+=y*y;
+			}
+		}
+	}
+
+	double covariance() const { return (count!=0)?xy/(double)count:0.0; }
+	double correlation() const { return xy/::sqrt(xx*yy); }
+
+private:
+	double xy, xx, yy;
+	unsigned count;
+};
+
+}
+
+double mean(const Sequence& s)
+{
+	double sum=0.0;
+	unsigned count=0;
+	const Sequence::Values values=s.get_values();
+	for(unsigned i=0; i<values.size(); ++i)
+		if(!std::isnan(values[i])) { sum+=values[i]; ++count; }
+	return (count!=0)?sum/(double)count:0.0;
+}
+
+double mean_square(const Sequence& s)
+{
+	double sum=0.0;
+	unsigned count=0;
+	const Sequence::Values values=s.get_values();
+	for(unsigned i=0; i<values.size(); ++i)
+		if(!std::isnan(values[i]))
+		{
+			sum+=(double)values[i]*(double)values[i];
+			++count;
+		}
+	return (count!=0)?sum/(double)count:0.0;
+}
+
+double mean_product(const Sequence& s, const Sequence& t)
+{
+	AlignmentPlan p;
+	return mean_product(s, t, p);
+}
+
+double slope(const Sequence& s, const Sequence& t)
+{
+	AlignmentPlan p;
+	return slope(s, t, p);
+}
+
+double variance(const Sequence& s)
+{
+	double m=mean(s), sum=0.0;
+	unsigned count=0;
+	const Sequence::Values values=s.get_values();
+	for(unsigned i=0; i<values.size(); ++i)
+		if(!std::isnan(values[i]))
+		{
+			double d=(double)values[i]-m;
+			sum+=d*d;
+			++count;
+		}
+	return (count!=0)?sum/(double)count:0.0;
+}
+
+double covariance(const Sequence& s, const Sequence& t)
+{
+	AlignmentPlan p;
+	return covariance(s, t, p);
+}
+
+double correlation(const Sequence& s, const Sequence& t)
+{
+	AlignmentPlan p;
+	return correlation(s, t, p);
+}
+
+double mean_product(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+{
+	return Moments(s, t, p).mean_product();
+}
+
+double slope(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+{
+	Moments m(s, t, p);
+	return m.mean_product()/m.second_mean_square();
+}
+
+double covariance(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+{
+	return CentralMoments(s, t, p).covariance();
+}
+
+double correlation(const Sequence& s, const Sequence& t, AlignmentPlan& p)
+{
+	return CentralMoments(s, t, p).correlation();
+}
+
+}
@@ -0,0 +1,52 @@
+/*
+ *      CnvReductions.hh - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CNVREDUCTIONS_
+#define _CNVREDUCTIONS_
+#include "CnvSequence.hh"
+
+/* This file defines reductions of data sequences to single numbers. They
+   accumulate in double precision over one or two aligned sequences and skip
+   NaN values like Cnv::avg does. mean_square, mean_product and slope take
+   the second moments about zero, as the filter and the eliminate macro do
+   with their centered sequences. slope is the factor of a least squares fit
+   of the first sequence by the second through the origin. variance,
+   covariance and correlation take them about the means, in a second pass.
+   Those of two sequences use only the aligned data points where neither
+   value is NaN. All of them divide by the number of values, not by one
+   less. */
+
+namespace Cnv {
+
+double	mean		(const Sequence&);
+double	mean_square	(const Sequence&);
+double	mean_product	(const Sequence&, const Sequence&);
+double	slope		(const Sequence&, const Sequence&);
+double	variance	(const Sequence&);
+double	covariance	(const Sequence&, const Sequence&);
+double	correlation	(const Sequence&, const Sequence&);
+
+double	mean_product	(const Sequence&, const Sequence&, AlignmentPlan&);
+double	slope		(const Sequence&, const Sequence&, AlignmentPlan&);
+double	covariance	(const Sequence&, const Sequence&, AlignmentPlan&);
+double	correlation	(const Sequence&, const Sequence&, AlignmentPlan&);
+
+}
+
+#endif
@@ -19,9 +19,14 @@
 
 #include "CnvSequence.hh"
 
+#include "CnvEncodeDecode.hh"
+
+#include <climits>
 #include <string>
 #include <vector>
 #include <list>
+#include <memory>
+#include <algorithm>
 
 /* The CnvSequence class if used as the basic container of noise-free-cnv to
    store the actual data sequences. From the outside it is similar to
@@ -31,40 +36,217 @@
    through several data sequences at once and are able to work on Sequences that
    are not exactly identical. In that case, the increment operators will find
    the nearest match where the data points in all sequences share the same name
-   string. */
+   string.
+
+   Next to the name strings, a Sequence keeps the chromosome and position of
+   every named data point in two packed columns. They are decoded once when the
+   data is loaded, so that later consumers do not have to parse the
+   "id/chr/pos" name strings again.
+
+   The names, chromosomes and positions make up the probe manifest of a
+   Sequence. Manifests are reference counted and never modified while shared,
+   so operations that keep the set of data points unchanged hand the manifest
+   of their input to the result and only compute a new value column.
+
+   The values are normally kept in a vector of the Sequence. They can also be
+   borrowed from memory that belongs to someone else, such as a mapped cache
+   file, which is kept alive by a shared pointer for as long as the Sequence
+   borrows from it. Appending to a Sequence that borrows its values copies
+   them first. get_values gives a read only view of the values either way. */
 
 namespace Cnv {
 
+static const std::vector<StringPointer> no_names;
+static const std::vector<unsigned char> no_chromosomes;
+static const std::vector<unsigned> no_positions;
+
+Sequence::Sequence():borrowed(NULL) {}
+
+//	The new Sequence shares the manifest m and expects one value per data
+//	point of the manifest to be appended with push_back. As long as the
+//	appended names follow the manifest, no names are copied.
+Sequence::Sequence(const ManifestPointer& m)
+	:manifest(std::const_pointer_cast<Manifest>(m)),borrowed(NULL)
+	{}
+
+//	The new Sequence has one value for every data point of the manifest m,
+//	read from v. They are not copied; owner has to keep v unchanged.
+Sequence::Sequence(const ManifestPointer& m, const value_type* v,
+	const std::shared_ptr<const void>& o)
+	:manifest(std::const_pointer_cast<Manifest>(m)),borrowed(v),owner(o)
+	{
+		if(!manifest) { borrowed=NULL; owner.reset(); }
+	}
+
 void Sequence::push_back(StringPointer name, float value)
 {
-	if(name||names.size()!=0) names.push_back(name);
+	unsigned char chr=UCHAR_MAX;
+	unsigned pos=0;
+	if(name)
+	{
+		std::string id;
+		decompose_point_name(name, id, chr, pos);
+	}
+	push_back(name, value, chr, pos);
+}
+
+void Sequence::push_back(StringPointer name, float value,
+	unsigned char chr, unsigned pos)
+{
+	own_values();
+	if(get_names().size()>values.size()
+		&&get_names()[values.size()]==name)
+	{
+		values.push_back(value);
+		return;
+	}
+
+	if(name||get_names().size()!=0)
+	{
+		Manifest& m=modify_manifest();
+		m.names.push_back(name);
+		m.chromosomes.push_back(chr);
+		m.positions.push_back(pos);
+	}
 	values.push_back(value);
 }
 
 void Sequence::push_back(float value)
 {
+	own_values();
+	if(get_names().size()>values.size())
+	{
+		values.push_back(value);
+		return;
+	}
+
 	values.push_back(value);
-	if(names.size()!=0) names.push_back(StringPointer());
+	if(get_names().size()!=0)
+	{
+		Manifest& m=modify_manifest();
+		m.names.push_back(StringPointer());
+		m.chromosomes.push_back(UCHAR_MAX);
+		m.positions.push_back(0);
+	}
+}
+
+//	Appends n values and returns them for writing, so that whole columns can
+//	be filled at once. The new data points are those of push_back(value).
+Sequence::value_type* Sequence::extend(unsigned n)
+{
+	own_values();
+	unsigned first=values.size();
+	if(get_names().size()==0||get_names().size()>=first+n)
+		values.resize(first+n);
+	else for(unsigned i=0; i<n; ++i) push_back(0.0f);
+	return values.data()+first;
+}
+
+//	Returns a manifest that is owned by this Sequence alone and has no more
+//	data points than there are values, copying the shared one if necessary.
+Sequence::Manifest& Sequence::modify_manifest()
+{
+	if(!manifest)
+	{
+		manifest.reset(new Manifest);
+		manifest->names.reserve(values.capacity());
+		manifest->chromosomes.reserve(values.capacity());
+		manifest->positions.reserve(values.capacity());
+	}
+	else if(manifest.use_count()>1||manifest->names.size()>values.size())
+	{
+		unsigned n=std::min((size_t)manifest->names.size(), values.size());
+		std::shared_ptr<Manifest> copy(new Manifest);
+		copy->names.reserve(values.capacity());
+		copy->chromosomes.reserve(values.capacity());
+		copy->positions.reserve(values.capacity());
+		copy->names.assign(manifest->names.begin(),
+			manifest->names.begin()+n);
+		copy->chromosomes.assign(manifest->chromosomes.begin(),
+			manifest->chromosomes.begin()+n);
+		copy->positions.assign(manifest->positions.begin(),
+			manifest->positions.begin()+n);
+		manifest=copy;
+	}
+	return *manifest;
+}
+
+//	Copies borrowed values into the vector of this Sequence, so that they
+//	can be modified, and lets go of their owner.
+void Sequence::own_values()
+{
+	if(!owner) return;
+	values.assign(borrowed, borrowed+manifest->names.size());
+	borrowed=NULL;
+	owner.reset();
+}
+
+bool Sequence::shares_manifest(const Sequence& s) const
+{
+	return manifest==s.manifest&&size()==s.size()
+		&&(!manifest||manifest->names.size()==size());
+}
+
+void Sequence::reserve(size_t size)
+{
+	own_values();
+	values.reserve(size);
+	if(manifest&&manifest.use_count()==1)
+	{
+		manifest->names.reserve(size);
+		manifest->chromosomes.reserve(size);
+		manifest->positions.reserve(size);
+	}
 }
 
 const std::vector<StringPointer>& Sequence::get_names() const
 {
-	return names;
+	if(manifest) return manifest->names;
+	else return no_names;
+}
+
+Sequence::Values Sequence::get_values() const
+{
+	if(owner) return Values(borrowed, manifest->names.size());
+	else return Values(values.data(), values.size());
+}
+
+const std::vector<unsigned char>& Sequence::get_chromosomes() const
+{
+	if(manifest) return manifest->chromosomes;
+	else return no_chromosomes;
+}
+
+const std::vector<unsigned>& Sequence::get_positions() const
+{
+	if(manifest) return manifest->positions;
+	else return no_positions;
 }
 
-const std::vector<float>& Sequence::get_values() const
+unsigned char Sequence::chromosome(unsigned i) const
 {
-	return values;
+	if(i<get_chromosomes().size()) return get_chromosomes()[i];
+	else return UCHAR_MAX;
+}
+
+unsigned Sequence::position(unsigned i) const
+{
+	if(i<get_positions().size()) return get_positions()[i];
+	else return 0;
 }
 
 SequenceSingleIterator::SequenceSingleIterator(const SequenceSingleIterator& m):
 	name_it(m.name_it),name_end(m.name_end),
-	value_it(m.value_it),value_end(m.value_end)
+	value_it(m.value_it),value_end(m.value_end),
+	chr_it(m.chr_it),chr_end(m.chr_end),
+	pos_it(m.pos_it),pos_end(m.pos_end)
 	{}
 
 SequenceSingleIterator::SequenceSingleIterator(const Sequence& s):
 	name_it(s.get_names().begin()),name_end(s.get_names().end()),
-	value_it(s.get_values().begin()),value_end(s.get_values().end())
+	value_it(s.get_values().begin()),value_end(s.get_values().end()),
+	chr_it(s.get_chromosomes().begin()),chr_end(s.get_chromosomes().end()),
+	pos_it(s.get_positions().begin()),pos_end(s.get_positions().end())
 	{}
 
 SequenceSingleIterator::operator bool() const
@@ -76,6 +258,8 @@ SequenceSingleIterator& SequenceSingleIterator::operator++()
 {
 	if(name_it!=name_end) ++name_it;
 	if(value_it!=value_end) ++value_it;
+	if(chr_it!=chr_end) ++chr_it;
+	if(pos_it!=pos_end) ++pos_it;
 	return *this;
 }
 
@@ -98,35 +282,233 @@ StringPointer SequenceSingleIterator::name() const
 	else return StringPointer();
 }
 
+unsigned char SequenceSingleIterator::chromosome() const
+{
+	if(chr_it!=chr_end) return *chr_it;
+	else return UCHAR_MAX;
+}
+
+unsigned SequenceSingleIterator::position() const
+{
+	if(pos_it!=pos_end) return *pos_it;
+	else return 0;
+}
+
+//	This class finds the next occurrence of a name in a vector of names. It
+//	keeps the first unused position of every name id and a chain to the next
+//	position with the same name, so duplicated names are handled as well.
+//	Since the search positions never decrease, every chain is walked only once.
+static const unsigned none=UINT_MAX;
+
+class NameIndex
+{
+public:
+
+	NameIndex(const std::vector<StringPointer>& names)
+		:next(names.size(), none)
+	{
+		unsigned max_id=0;
+		for(unsigned i=0; i<names.size(); ++i)
+			max_id=std::max(max_id, names[i].id());
+		head.resize(max_id+1, none);
+
+		for(unsigned i=names.size(); i-->0; )
+		{
+			next[i]=head[names[i].id()];
+			head[names[i].id()]=i;
+		}
+	}
+
+	unsigned find(StringPointer name, unsigned from)
+	{
+		if(name.id()>=head.size()) return none;
+		unsigned pos=head[name.id()];
+		while(pos!=none&&pos<from) pos=next[pos];
+		head[name.id()]=pos;
+		return pos;
+	}
+
+private:
+
+	std::vector<unsigned> head;
+	std::vector<unsigned> next;
+};
+
+//	Greedily matches the names in a and b. Starting from the last match, it
+//	picks the next pair of equal names that is closest to the diagonal, exactly
+//	like the nested scan that was used by the iterators before, but it looks
+//	up the candidates in the NameIndex instead of comparing all of them.
+static void match_names(const std::vector<StringPointer>& a,
+	const std::vector<StringPointer>& b,
+	std::vector<unsigned>& out_a, std::vector<unsigned>& out_b)
+{
+	NameIndex index_a(a), index_b(b);
+
+	unsigned i=0, j=0;
+	while(i<a.size()&&j<b.size())
+	{
+		if(a[i]==b[j])
+		{
+			out_a.push_back(i++);
+			out_b.push_back(j++);
+			continue;
+		}
+
+		bool found=false;
+		for(unsigned k=1; !found; ++k)
+		{
+			bool in_a=i+k<a.size(), in_b=j+k<b.size();
+			if(!in_a&&!in_b) return;
+
+			unsigned p=in_a?index_b.find(a[i+k], j):none;
+			unsigned q=in_b?index_a.find(b[j+k], i):none;
+			bool cand_a=p!=none&&p-j<k;
+			bool cand_b=q!=none&&q-i<k;
+
+			if(cand_a&&(!cand_b||p-j<=q-i)) { i+=k; j=p; found=true; }
+			else if(cand_b) { i=q; j+=k; found=true; }
+			else if(p!=none&&p-j==k) { i+=k; j=p; found=true; }
+		}
+	}
+}
+
+AlignmentPlan::AlignmentPlan() {}
+
+AlignmentPlan::AlignmentPlan(const Sequence& s, const Sequence& t)
+{
+	std::vector<const Sequence*> tmp;
+	tmp.push_back(&s);
+	tmp.push_back(&t);
+	data=align(tmp);
+}
+
+AlignmentPlan::AlignmentPlan(const std::vector<const Sequence*>& s)
+	:data(align(s))
+	{}
+
+bool AlignmentPlan::fits(const Sequence& s, const Sequence& t) const
+{
+	return data&&data->sizes.size()==2
+		&&data->manifests[0]==s.get_manifest()&&data->sizes[0]==s.size()
+		&&data->manifests[1]==t.get_manifest()&&data->sizes[1]==t.size();
+}
+
+bool AlignmentPlan::fits(const std::vector<const Sequence*>& s) const
+{
+	if(!data||data->sizes.size()!=s.size()) return false;
+	for(unsigned i=0; i<s.size(); ++i)
+		if(data->manifests[i]!=s[i]->get_manifest()
+			||data->sizes[i]!=s[i]->size()) return false;
+	return true;
+}
+
+//	Returns the manifest shared by all the aligned sequences if there is one.
+//	Results of operations over them contain exactly the same data points.
+Sequence::ManifestPointer AlignmentPlan::manifest() const
+{
+	if(!data||data->manifests.empty()||!data->matches.empty())
+		return Sequence::ManifestPointer();
+	for(unsigned i=0; i<data->sizes.size(); ++i)
+		if(data->sizes[i]!=data->count) return Sequence::ManifestPointer();
+	return data->manifests[0];
+}
+
+std::shared_ptr<const AlignmentPlan::Data> AlignmentPlan::align(
+	const std::vector<const Sequence*>& s)
+{
+	std::shared_ptr<Data> out(new Data);
+	out->count=0;
+	out->columns.assign(s.size(), -1);
+	for(unsigned i=0; i<s.size(); ++i)
+	{
+		out->manifests.push_back(s[i]->get_manifest());
+		out->sizes.push_back(s[i]->size());
+	}
+	if(s.empty()) return out;
+
+	bool unnamed=false;
+	out->count=s[0]->size();
+	for(unsigned i=0; i<s.size(); ++i)
+	{
+		out->count=std::min(out->count, s[i]->size());
+		if(s[i]->get_names().empty()) unnamed=true;
+	}
+
+	std::vector<unsigned> group(s.size(), 0);
+	std::vector<unsigned> representative;
+	representative.push_back(0);
+	if(!unnamed) for(unsigned i=1; i<s.size(); ++i)
+	{
+		unsigned g;
+		for(g=0; g<representative.size(); ++g)
+		{
+			const Sequence& r=*s[representative[g]];
+			if(r.shares_manifest(*s[i])||r.get_names()==s[i]->get_names())
+				break;
+		}
+		if(g==representative.size()) representative.push_back(i);
+		group[i]=g;
+	}
+
+	if(representative.size()==1) return out;
+
+	std::vector<std::vector<unsigned> >& matches=out->matches;
+	matches.resize(representative.size());
+	const std::vector<StringPointer>& first=s[0]->get_names();
+	for(unsigned k=0; k<first.size(); ++k) matches[0].push_back(k);
+
+	for(unsigned g=1; g<representative.size(); ++g)
+	{
+		std::vector<StringPointer> reference;
+		reference.reserve(matches[0].size());
+		for(unsigned k=0; k<matches[0].size(); ++k)
+			reference.push_back(first[matches[0][k]]);
+
+		std::vector<unsigned> kept, found;
+		match_names(reference, s[representative[g]]->get_names(),
+			kept, found);
+
+		for(unsigned h=0; h<g; ++h)
+		{
+			std::vector<unsigned> filtered(kept.size());
+			for(unsigned k=0; k<kept.size(); ++k)
+				filtered[k]=matches[h][kept[k]];
+			matches[h].swap(filtered);
+		}
+		matches[g].swap(found);
+	}
+
+	out->count=matches[0].size();
+	for(unsigned i=0; i<s.size(); ++i) out->columns[i]=group[i];
+	return out;
+}
+
 SequenceDualIterator::SequenceDualIterator(const SequenceDualIterator& m)
-	:name_it1(m.name_it1),name_it2(m.name_it2),
-	name_end1(m.name_end1),name_end2(m.name_end2),
-	value_it1(m.value_it1),value_it2(m.value_it2),
-	value_end1(m.value_end1),value_end2(m.value_end2)
+	:seq1(m.seq1),seq2(m.seq2),plan(m.plan),current(m.current)
 	{}
 
 SequenceDualIterator::SequenceDualIterator(const Sequence& s, const Sequence& t)
-	:name_it1(s.get_names().begin()),name_it2(t.get_names().begin()),
-	name_end1(s.get_names().end()),name_end2(t.get_names().end()),
-	value_it1(s.get_values().begin()),value_it2(t.get_values().begin()),
-	value_end1(s.get_values().end()),value_end2(t.get_values().end())
+	:seq1(&s),seq2(&t),plan(s, t),current(0)
+	{}
+
+//	Uses the plan p if it fits s and t. Otherwise a new plan is computed and
+//	stored in p, so that it can be reused by subsequent operations.
+SequenceDualIterator::SequenceDualIterator(const Sequence& s, const Sequence& t,
+	AlignmentPlan& p)
+	:seq1(&s),seq2(&t),current(0)
 {
-	find_match();
+	if(!p.fits(s, t)) p=AlignmentPlan(s, t);
+	plan=p;
 }
 
 SequenceDualIterator::operator bool() const
 {
-	return value_it1!=value_end1&&value_it2!=value_end2;
+	return current<plan.size();
 }
 
 SequenceDualIterator& SequenceDualIterator::operator++()
 {
-	if(name_it1!=name_end1) ++name_it1;
-	if(value_it1!=value_end1) ++value_it1;
-	if(name_it2!=name_end2) ++name_it2;
-	if(value_it2!=value_end2) ++value_it2;
-
-	find_match();
+	if(current<plan.size()) ++current;
 	return *this;
 }
 
@@ -139,122 +521,83 @@ SequenceDualIterator SequenceDualIterator::operator++(int)
 
 float SequenceDualIterator::first() const
 {
-	if(value_it1!=value_end1) return *value_it1;
+	if(current<plan.size())
+		return seq1->get_values()[plan.index(current, 0)];
 	else return 0.0f;
 }
 
 float SequenceDualIterator::second() const
 {
-	if(value_it2!=value_end2) return *value_it2;
+	if(current<plan.size())
+		return seq2->get_values()[plan.index(current, 1)];
 	else return 0.0f;
 }
 
 StringPointer SequenceDualIterator::name() const
 {
-	if(name_it1!=name_end1) return *name_it1;
+	unsigned i=(current<plan.size())?plan.index(current, 0):0;
+	if(current<plan.size()&&i<seq1->get_names().size())
+		return seq1->get_names()[i];
 	else return StringPointer();
 }
 
-void SequenceDualIterator::find_match()
+unsigned char SequenceDualIterator::chromosome() const
 {
-	std::vector<StringPointer>::const_iterator old_it1=name_it1;
-	std::vector<StringPointer>::const_iterator old_it2=name_it2;
-	find_match_helper(name_it1, name_it2, name_end1, name_end2);
-
-	if(name_it1-old_it1>value_end1-value_it1)
-		value_it1=value_end1;
-	else value_it1=value_it1+(name_it1-old_it1);
-
-	if(name_it2-old_it2>value_end2-value_it2)
-		value_it2=value_end2;
-	else value_it2=value_it2+(name_it2-old_it2);
+	if(current<plan.size())
+		return seq1->chromosome(plan.index(current, 0));
+	else return UCHAR_MAX;
 }
 
-void SequenceDualIterator::find_match_helper(
-	std::vector<StringPointer>::const_iterator& it1,
-	std::vector<StringPointer>::const_iterator& it2,
-	const std::vector<StringPointer>::const_iterator& end1,
-	const std::vector<StringPointer>::const_iterator& end2)
+unsigned SequenceDualIterator::position() const
 {
-	int off1, off2;
-	for(off1=0; off1<std::min(end1-it1, end2-it2); ++off1)
-	{
-		for(off2=0; off2<off1; ++off2)
-		{
-			if(it1[off1]==it2[off2])
-				{ it1+=off1; it2+=off2; return; }
-			else if(it1[off2]==it2[off1])
-				{ it1+=off2; it2+=off1; return; }
-		}
-		if(it1[off1]==it2[off1])
-			{ it1+=off1; it2+=off1; return; }
-	}
-
-	for(; off1<end1-it1; ++off1)
-		for(off2=0; off2<end2-it2; ++off2)
-			if(it1[off1]==it2[off2])
-				{ it1+=off1; it2+=off2; return; }
-
-	for(; off1<end2-it2; ++off1)
-		for(off2=0; off2<end1-it1; ++off2)
-			if(it1[off2]==it2[off1])
-				{ it1+=off2; it2+=off1; return; }
+	if(current<plan.size())
+		return seq1->position(plan.index(current, 0));
+	else return 0;
 }
 
 SequenceMultiIterator::SequenceMultiIterator(const SequenceMultiIterator& m):
-	name_it(m.name_it),name_end(m.name_end),
-	value_it(m.value_it),value_end(m.value_end)
+	seqs(m.seqs),plan(m.plan),current(m.current)
 	{}
 
-
 SequenceMultiIterator::SequenceMultiIterator(const std::vector<const Sequence*>& s)
+	:current(0)
 {
 	std::vector<const Sequence*>::const_iterator it;
 	for(it=s.begin(); it!=s.end(); ++it)
-	{
-		if(*it!=NULL)
-		{
-			name_it.push_back((*it)->get_names().begin());
-			name_end.push_back((*it)->get_names().end());
-			value_it.push_back((*it)->get_values().begin());
-			value_end.push_back((*it)->get_values().end());
-		}
-	}
-	find_match();
+		if(*it!=NULL) seqs.push_back(*it);
+	plan=AlignmentPlan(seqs);
 }
 
 SequenceMultiIterator::SequenceMultiIterator(const std::vector<Sequence*>& s)
+	:current(0)
 {
 	std::vector<Sequence*>::const_iterator it;
 	for(it=s.begin(); it!=s.end(); ++it)
-	{
-		if(*it!=NULL)
-		{
-			name_it.push_back((*it)->get_names().begin());
-			name_end.push_back((*it)->get_names().end());
-			value_it.push_back((*it)->get_values().begin());
-			value_end.push_back((*it)->get_values().end());
-		}
-	}
-	find_match();
+		if(*it!=NULL) seqs.push_back(*it);
+	plan=AlignmentPlan(seqs);
+}
+
+//	Uses the plan p if it fits the sequences in s that are not NULL.
+//	Otherwise a new plan is computed and stored in p.
+SequenceMultiIterator::SequenceMultiIterator(
+	const std::vector<const Sequence*>& s, AlignmentPlan& p)
+	:current(0)
+{
+	std::vector<const Sequence*>::const_iterator it;
+	for(it=s.begin(); it!=s.end(); ++it)
+		if(*it!=NULL) seqs.push_back(*it);
+	if(!p.fits(seqs)) p=AlignmentPlan(seqs);
+	plan=p;
 }
 
 SequenceMultiIterator::operator bool() const
 {
-	if(value_it.size()==0) return false;
-	for(unsigned i=0; i<value_it.size()&&i<value_end.size(); ++i)
-		if(value_it[i]==value_end[i]) return false;
-	return true;
+	return seqs.size()!=0&&current<plan.size();
 }
 
 SequenceMultiIterator& SequenceMultiIterator::operator++()
 {
-	for(unsigned i=0; i<name_it.size()&&i<name_end.size(); ++i)
-		if(name_it[i]!=name_end[i]) ++name_it[i];
-	for(unsigned i=0; i<value_it.size()&&i<value_it.size(); ++i)
-		if(value_it[i]!=value_end[i]) ++value_it[i];
-
-	find_match();
+	if(current<plan.size()) ++current;
 	return *this;
 }
 
@@ -267,69 +610,31 @@ SequenceMultiIterator SequenceMultiIterator::operator++(int)
 
 float SequenceMultiIterator::operator[](unsigned i) const
 {
-	if(i<value_it.size()&&i<value_end.size()
-		&&value_it[i]!=value_end[i])
-		return *(value_it[i]);
+	if(i<seqs.size()&&current<plan.size())
+		return seqs[i]->get_values()[plan.index(current, i)];
 	else return 0.0f;
 }
 
 StringPointer SequenceMultiIterator::name() const
 {
-	if(name_it.size()!=0&&name_end.size()!=0
-		&&name_it[0]!=name_end[0])
-		return *(name_it[0]);
+	if(seqs.size()==0||current>=plan.size()) return StringPointer();
+	unsigned i=plan.index(current, 0);
+	if(i<seqs[0]->get_names().size()) return seqs[0]->get_names()[i];
 	else return StringPointer();
 }
 
-void SequenceMultiIterator::find_match()
+unsigned char SequenceMultiIterator::chromosome() const
 {
-	std::vector<std::vector<StringPointer>::const_iterator>
-		name_old=name_it;
-
-	bool again=true;
-	while(again)
-	{
-		again=false;
-
-		for(unsigned i=0; i<name_it.size()&&i<name_end.size(); i+=2)
-		{
-			std::vector<StringPointer>::const_iterator
-				it1=name_it[i];
-			std::vector<StringPointer>::const_iterator
-				it2=name_it[(i+1)%name_it.size()];
-
-			SequenceDualIterator::find_match_helper(
-				name_it[i], name_it[(i+1)%name_it.size()],
-				name_end[i], name_end[(i+1)%name_it.size()]);
-
-			if(it1!=name_it[i]||it2!=name_it[(i+1)%name_it.size()])
-				again=true;
-		}
-
-		for(unsigned i=1; i<name_it.size()&&i<name_end.size(); i+=2)
-		{
-			std::vector<StringPointer>::const_iterator
-				it1=name_it[i];
-			std::vector<StringPointer>::const_iterator
-				it2=name_it[(i+1)%name_it.size()];
-
-			SequenceDualIterator::find_match_helper(
-				name_it[i], name_it[(i+1)%name_it.size()],
-				name_end[i], name_end[(i+1)%name_it.size()]);
-
-			if(it1!=name_it[i]||it2!=name_it[(i+1)%name_it.size()])
-				again=true;
-		}
-	}
-
-	for(unsigned i=0; i<name_it.size()&&i<name_end.size()
-		&&i<value_it.size()&&i<value_end.size(); i+=2)
-	{
+	if(seqs.size()!=0&&current<plan.size())
+		return seqs[0]->chromosome(plan.index(current, 0));
+	else return UCHAR_MAX;
+}
 
-		if(name_it[i]-name_old[i]>value_end[i]-value_it[i])
-			value_it[i]=value_end[i];
-		else value_it[i]=value_it[i]+(name_it[i]-name_old[i]);
-	}
+unsigned SequenceMultiIterator::position() const
+{
+	if(seqs.size()!=0&&current<plan.size())
+		return seqs[0]->position(plan.index(current, 0));
+	else return 0;
 }
 
 }
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <memory>
 
 /* The CnvSequence class if used as the basic container of noise-free-cnv to
    store the actual data sequences. From the outside it is similar to
@@ -32,7 +33,23 @@
    through several data sequences at once and are able to work on Sequences that
    are not exactly identical. In that case, the increment operators will find
    the nearest match where the data points in all sequences share the same name
-   string. */
+   string.
+
+   Next to the name strings, a Sequence keeps the chromosome and position of
+   every named data point in two packed columns. They are decoded once when the
+   data is loaded, so that later consumers do not have to parse the
+   "id/chr/pos" name strings again.
+
+   The names, chromosomes and positions make up the probe manifest of a
+   Sequence. Manifests are reference counted and never modified while shared,
+   so operations that keep the set of data points unchanged hand the manifest
+   of their input to the result and only compute a new value column.
+
+   The values are normally kept in a vector of the Sequence. They can also be
+   borrowed from memory that belongs to someone else, such as a mapped cache
+   file, which is kept alive by a shared pointer for as long as the Sequence
+   borrows from it. Appending to a Sequence that borrows its values copies
+   them first. get_values gives a read only view of the values either way. */
 
 namespace Cnv {
 
@@ -41,18 +58,72 @@ class Sequence
 public:
 	typedef float value_type;
 
+	class Manifest
+	{
+	public:
+		std::vector<StringPointer> names;
+		std::vector<unsigned char> chromosomes;
+		std::vector<unsigned> positions;
+	};
+
+	typedef std::shared_ptr<const Manifest> ManifestPointer;
+
+	//	A read only view of the values of a Sequence. It stays valid until
+	//	the Sequence is modified or destroyed.
+	class Values
+	{
+	public:
+		typedef const value_type* const_iterator;
+
+		Values(const value_type* d, unsigned n):first(d),count(n) {}
+
+		const value_type* data() const { return first; }
+		unsigned size() const { return count; }
+		bool empty() const { return count==0; }
+		const_iterator begin() const { return first; }
+		const_iterator end() const { return first+count; }
+		const value_type& operator[](unsigned i) const { return first[i]; }
+
+	private:
+		const value_type* first;
+		unsigned count;
+	};
+
+	Sequence();
+	explicit Sequence(const ManifestPointer& m);
+	Sequence(const ManifestPointer& m, const value_type* v,
+		const std::shared_ptr<const void>& owner);
+
 	void push_back(StringPointer s, value_type value);
+	void push_back(StringPointer s, value_type value,
+		unsigned char chr, unsigned pos);
 	void push_back(value_type value);
+	value_type* extend(unsigned n);
 
 	const std::vector<StringPointer>& get_names() const;
-	const std::vector<value_type>& get_values() const;
+	Values get_values() const;
+	const std::vector<unsigned char>& get_chromosomes() const;
+	const std::vector<unsigned>& get_positions() const;
+
+	unsigned char chromosome(unsigned i) const;
+	unsigned position(unsigned i) const;
+
+	ManifestPointer get_manifest() const { return manifest; }
+	bool shares_manifest(const Sequence& s) const;
+	bool borrows_values() const { return (bool)owner; }
 
-	void reserve(size_t size) { values.reserve(size); };
-	unsigned size() const {return values.size(); }
+	void reserve(size_t size);
+	unsigned size() const
+		{return (owner)?manifest->names.size():values.size(); }
 
 private:
-	std::vector<StringPointer> names;
+	Manifest& modify_manifest();
+	void own_values();
+
+	std::shared_ptr<Manifest> manifest;
 	std::vector<value_type> values;
+	const value_type* borrowed;
+	std::shared_ptr<const void> owner;
 };
 
 
@@ -70,13 +141,68 @@ public:
 
 	float value() const;
 	StringPointer name() const;
+	unsigned char chromosome() const;
+	unsigned position() const;
 
 private:
 
 	std::vector<StringPointer>::const_iterator name_it;
 	std::vector<StringPointer>::const_iterator name_end;
-	std::vector<float>::const_iterator value_it;
-	std::vector<float>::const_iterator value_end;
+	Sequence::Values::const_iterator value_it;
+	Sequence::Values::const_iterator value_end;
+	std::vector<unsigned char>::const_iterator chr_it;
+	std::vector<unsigned char>::const_iterator chr_end;
+	std::vector<unsigned>::const_iterator pos_it;
+	std::vector<unsigned>::const_iterator pos_end;
+};
+
+//	This class matches the data points of two or more sequences by their
+//	names. The matches are computed once, in linear time, with an index over
+//	the interned name ids. Sequences with identical names are matched by
+//	position without building any index.
+//
+//	A plan remembers the manifests and sizes of the sequences it was built
+//	for. Since shared manifests are never modified, a plan that fits a set of
+//	sequences can be reused for any operation on them or on sequences derived
+//	from them. Copies of a plan share the matched indices.
+class AlignmentPlan
+{
+public:
+
+	AlignmentPlan();
+	AlignmentPlan(const Sequence& s, const Sequence& t);
+	AlignmentPlan(const std::vector<const Sequence*>& s);
+
+	bool fits(const Sequence& s, const Sequence& t) const;
+	bool fits(const std::vector<const Sequence*>& s) const;
+
+	Sequence::ManifestPointer manifest() const;
+
+	unsigned size() const { return (data)?data->count:0; }
+	unsigned width() const { return (data)?data->columns.size():0; }
+
+	unsigned index(unsigned k, unsigned i) const
+	{
+		int slot=data->columns[i];
+		return (slot>=0)?data->matches[slot][k]:k;
+	}
+
+private:
+
+	class Data
+	{
+	public:
+		unsigned count;
+		std::vector<int> columns;
+		std::vector<std::vector<unsigned> > matches;
+		std::vector<Sequence::ManifestPointer> manifests;
+		std::vector<unsigned> sizes;
+	};
+
+	static std::shared_ptr<const Data> align(
+		const std::vector<const Sequence*>& s);
+
+	std::shared_ptr<const Data> data;
 };
 
 class SequenceDualIterator
@@ -85,6 +211,8 @@ public:
 
 	SequenceDualIterator(const SequenceDualIterator& m);
 	SequenceDualIterator(const Sequence& s, const Sequence& t);
+	SequenceDualIterator(const Sequence& s, const Sequence& t,
+		AlignmentPlan& p);
 
 	operator bool() const;
 
@@ -94,21 +222,15 @@ public:
 	float first() const;
 	float second() const;
 	StringPointer name() const;
-
-	static void find_match_helper(
-		std::vector<StringPointer>::const_iterator& it1,
-		std::vector<StringPointer>::const_iterator& it2,
-		const std::vector<StringPointer>::const_iterator& end1,
-		const std::vector<StringPointer>::const_iterator& end2);
+	unsigned char chromosome() const;
+	unsigned position() const;
 
 private:
 
-	void find_match();
-
-	std::vector<StringPointer>::const_iterator name_it1, name_it2;
-	std::vector<StringPointer>::const_iterator name_end1, name_end2;
-	std::vector<float>::const_iterator value_it1, value_it2;
-	std::vector<float>::const_iterator value_end1, value_end2;
+	const Sequence* seq1;
+	const Sequence* seq2;
+	AlignmentPlan plan;
+	unsigned current;
 };
 
 class SequenceMultiIterator
@@ -118,6 +240,8 @@ public:
 	SequenceMultiIterator(const SequenceMultiIterator& m);
 	SequenceMultiIterator(const std::vector<const Sequence*>& s);
 	SequenceMultiIterator(const std::vector<Sequence*>& s);
+	SequenceMultiIterator(const std::vector<const Sequence*>& s,
+		AlignmentPlan& p);
 
 	operator bool() const;
 
@@ -126,15 +250,14 @@ public:
 
 	float operator[](unsigned i) const;
 	StringPointer name() const;
+	unsigned char chromosome() const;
+	unsigned position() const;
 
 private:
 
-	void find_match();
-
-	std::vector<std::vector<StringPointer>::const_iterator> name_it;
-	std::vector<std::vector<StringPointer>::const_iterator> name_end;
-	std::vector<std::vector<float>::const_iterator> value_it;
-	std::vector<std::vector<float>::const_iterator> value_end;
+	std::vector<const Sequence*> seqs;
+	AlignmentPlan plan;
+	unsigned current;
 };
 
 }
@@ -0,0 +1,297 @@
+/*
+ *      CnvSketch.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvSketch.hh"
+
+#include <glibmm.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+/* This file defines a summary of many aligned sequences from which their
+   median can be extracted, like Cnv::median does, without keeping all the
+   sequences in memory. Every data point keeps a stack of compactors. Values
+   are added to the lowest one, and a full compactor is sorted and passes
+   every other value on to the next one, where they count twice. As in the
+   KLL sketch of Karnin, Lang and Liberty, the top compactor holds k values
+   and every one below it two thirds of the one above, at least two. When
+   the top one overflows, a new one is put on top and the others shrink.
+   The memory per data point therefore stays below 3k values and two bytes
+   per compactor, however many sequences are added. While the single first
+   compactor is not full, it only takes as much memory as it holds values.
+
+   Up to k sequences, the median is exact. Beyond that, a compaction at the
+   level l moves the rank of the returned median by at most 2^l. For n
+   sequences and compactors of c values, the rank therefore differs from n/2
+   by at most the sum of n/c over all compactors but the top one, plus
+   2^l for every compactor of the level l that shrinks when a level is
+   added. NaN values are skipped, and only the data points that are present
+   in all sequences make it into the result. */
+
+namespace Cnv {
+
+namespace {
+
+//	Data points per thread below which starting another thread does not pay.
+const unsigned sketch_thread_points=1<<14;
+
+//	Calls f(first, last) for consecutive ranges of the data points 0 to n,
+//	on one thread per processor.
+template<class F> void for_ranges(unsigned n, const F& f)
+{
+	unsigned threads=std::min(Glib::get_num_processors(),
+		n/sketch_thread_points);
+	threads=std::max(1u, threads);
+
+	std::vector<Glib::Threads::Thread*> workers;
+	for(unsigned t=1; t<threads; ++t)
+		workers.push_back(Glib::Threads::Thread::create(sigc::bind(f,
+			(unsigned)((unsigned long long)n*t/threads),
+			(unsigned)((unsigned long long)n*(t+1)/threads))));
+	f(0u, (unsigned)((unsigned long long)n/threads));
+	for(unsigned t=0; t<workers.size(); ++t)
+		workers[t]->join();
+}
+
+}
+
+//	An odd k is rounded up, so that the median stays exact up to k sequences.
+MedianSketch::MedianSketch(unsigned k)
+	:capacity(std::min((std::max(k, 2u)+1)&~1u, 0x7ffeu)),samples(0)
+	{}
+
+//	The capacity of the compactors distance levels below the top.
+unsigned MedianSketch::width(unsigned distance) const
+{
+	unsigned w=capacity;
+	for(; distance>0&&w>2; --distance) w=w*2/3;
+	return std::max(2u, w&~1u);
+}
+
+//	Levels are added and the first level grows before the values are
+//	inserted in parallel, so that no insertion needs memory that is not
+//	there yet.
+void MedianSketch::add(const Sequence& s)
+{
+	if(samples==0)
+	{
+		reference=s;
+		complete.assign(s.size(), true);
+		levels.assign(1, Level());
+		levels[0].counts.assign(s.size(), 0);
+		levels[0].width=capacity;
+		levels[0].stride=0;
+	}
+	++samples;
+
+	if(!plan.fits(reference, s)) plan=AlignmentPlan(reference, s);
+	std::vector<unsigned> index(reference.size(), UINT_MAX);
+	for(unsigned i=0; i<plan.size(); ++i)
+		index[plan.index(i, 0)]=plan.index(i, 1);
+	for(unsigned j=0; j<index.size(); ++j)
+		if(index[j]==UINT_MAX) complete[j]=false;
+
+	grow_first_level();
+	while(overflows(s, index)) add_level();
+
+	for_ranges(reference.size(), sigc::bind(sigc::mem_fun(*this,
+		&MedianSketch::insert_range), &s, &index));
+}
+
+//	Until the first compaction, the only level takes a quarter more room
+//	whenever the values of one more sequence would not fit.
+void MedianSketch::grow_first_level()
+{
+	Level& first=levels[0];
+	if(levels.size()>1||first.stride>=std::min(samples, first.width)) return;
+
+	unsigned stride=std::min(first.width,
+		std::max(samples, first.stride+first.stride/4+8));
+	std::vector<float> values((size_t)reference.size()*stride);
+	for(unsigned j=0; j<reference.size(); ++j)
+		std::copy(first.values.begin()+(size_t)j*first.stride,
+			first.values.begin()+(size_t)j*first.stride+first.counts[j],
+			values.begin()+(size_t)j*stride);
+	first.values.swap(values);
+	first.stride=stride;
+}
+
+//	True if inserting s would make the top compactor of a data point pass
+//	values on. Every full compactor on the way passes on half its capacity.
+bool MedianSketch::overflows(const Sequence& s,
+	const std::vector<unsigned>& index) const
+{
+	const Sequence::Values values=s.get_values();
+	for(unsigned j=0; j<index.size(); ++j)
+	{
+		if(index[j]==UINT_MAX||std::isnan(values[index[j]])) continue;
+		unsigned carry=1;
+		for(unsigned l=0; carry>0; ++l)
+		{
+			if(l+1==levels.size()&&(levels[l].counts[j]&0x7fff)+carry
+				>levels[l].width) return true;
+			if((levels[l].counts[j]&0x7fff)+carry<=levels[l].width) carry=0;
+			else carry=levels[l].width/2;
+		}
+	}
+	return false;
+}
+
+//	Puts a new compactor on top of every data point and shrinks the others
+//	to their new capacities. The levels are copied, so for a moment both
+//	copies are held.
+void MedianSketch::add_level()
+{
+	unsigned top=levels.size();
+	std::vector<Level> next(top+1);
+	for(unsigned l=0; l<=top; ++l)
+	{
+		next[l].width=next[l].stride=width(top-l);
+		next[l].values.resize((size_t)reference.size()*next[l].stride);
+		next[l].counts.assign(reference.size(), 0);
+	}
+
+	for_ranges(reference.size(), sigc::bind(sigc::mem_fun(*this,
+		&MedianSketch::relayout_range), &next));
+	levels.swap(next);
+}
+
+//	The levels are moved from the top down. A compactor that is more than
+//	half full for its new capacity is compacted into the one above it, which
+//	is then at most half full itself, and an odd value stays. So every
+//	compactor can take what the one below it passes on, which is at most
+//	half of its old capacity, the new capacity of the one above.
+void MedianSketch::relayout_range(unsigned first, unsigned last,
+	std::vector<Level>* next)
+{
+	for(unsigned j=first; j<last; ++j)
+		for(unsigned l=levels.size(); l-->0; )
+		{
+			unsigned short count=levels[l].counts[j];
+			unsigned n=count&0x7fff, offset=count>>15;
+			float* from=&levels[l].values[(size_t)j*levels[l].stride];
+			Level& to=(*next)[l];
+			Level& up=(*next)[l+1];
+			float* into=&to.values[(size_t)j*to.stride];
+			float* above=&up.values[(size_t)j*up.stride];
+
+			if(n<=to.width/2)
+			{
+				std::copy(from, from+n, into);
+				to.counts[j]=count;
+				continue;
+			}
+
+			std::sort(from, from+n);
+			unsigned skip=(n%2==1&&offset==1)?1:0;
+			to.counts[j]=(unsigned short)((offset^1)<<15);
+			if(n%2==1)
+			{
+				into[0]=from[(skip==1)?0:n-1];
+				++to.counts[j];
+			}
+			for(unsigned i=skip+offset; i<skip+(n&~1u); i+=2)
+				above[up.counts[j]++&0x7fff]=from[i];
+		}
+}
+
+void MedianSketch::insert_range(unsigned first, unsigned last,
+	const Sequence* s, const std::vector<unsigned>* index)
+{
+	const Sequence::Values values=s->get_values();
+	for(unsigned j=first; j<last; ++j)
+		if((*index)[j]!=UINT_MAX&&!std::isnan(values[(*index)[j]]))
+			insert(0, j, values[(*index)[j]]);
+}
+
+//	A full compactor keeps alternately the values at even and at odd ranks,
+//	so that the errors of successive compactions cancel out.
+void MedianSketch::insert(unsigned level, unsigned point, float value)
+{
+	Level& here=levels[level];
+	unsigned short& count=here.counts[point];
+	float* compactor=&here.values[(size_t)point*here.stride];
+
+	if((count&0x7fff)==here.width)
+	{
+		std::sort(compactor, compactor+here.width);
+		unsigned offset=count>>15;
+		count=(count^0x8000)&0x8000;
+		for(unsigned i=offset; i<here.width; i+=2)
+			insert(level+1, point, compactor[i]);
+	}
+	compactor[count&0x7fff]=value;
+	++count;
+}
+
+//	Every value stands for 2^level values of the sequences. The median is
+//	taken over all of them like Kernel::median does.
+void MedianSketch::median_range(unsigned first, unsigned last,
+	float* out) const
+{
+	std::vector<std::pair<float,unsigned long long> > weighted;
+	for(unsigned j=first; j<last; ++j)
+	{
+		weighted.clear();
+		unsigned long long total=0;
+		for(unsigned l=0; l<levels.size(); ++l)
+		{
+			unsigned count=levels[l].counts[j]&0x7fff;
+			const float* compactor=&levels[l].values[(size_t)j*levels[l].stride];
+			for(unsigned i=0; i<count; ++i)
+				weighted.push_back(std::make_pair(compactor[i], 1ull<<l));
+			total+=(unsigned long long)count<<l;
+		}
+
+		if(total==0) { out[j]=NAN; continue; }
+		std::sort(weighted.begin(), weighted.end());
+
+		float lower=NAN, upper=NAN;
+		unsigned long long rank=0;
+		for(unsigned i=0; i<weighted.size(); ++i)
+		{
+			rank+=weighted[i].second;
+			if(std::isnan(lower)&&rank>(total-1)/2) lower=weighted[i].first;
+			if(rank>total/2) { upper=weighted[i].first; break; }
+		}
+		out[j]=(total%2==1)?upper:(lower+upper)/2.0;
+	}
+}
+
+Sequence MedianSketch::median() const
+{
+	std::vector<float> medians(reference.size());
+	for_ranges(reference.size(), sigc::bind(sigc::mem_fun(*this,
+		&MedianSketch::median_range), medians.data()));
+
+	if(std::find(complete.begin(), complete.end(), false)==complete.end())
+	{
+		Sequence out(reference.get_manifest());
+		std::copy(medians.begin(), medians.end(), out.extend(medians.size()));
+		return out;
+	}
+
+	Sequence out; out.reserve(medians.size());
+	for(unsigned j=0; j<medians.size(); ++j)
+		if(complete[j]) out.push_back(reference.get_names()[j], medians[j],
+			reference.chromosome(j), reference.position(j));
+	return out;
+}
+
+}
@@ -0,0 +1,94 @@
+/*
+ *      CnvSketch.hh - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CNVSKETCH_
+#define _CNVSKETCH_
+#include "CnvSequence.hh"
+
+/* This file defines a summary of many aligned sequences from which their
+   median can be extracted, like Cnv::median does, without keeping all the
+   sequences in memory. Every data point keeps a stack of compactors. Values
+   are added to the lowest one, and a full compactor is sorted and passes
+   every other value on to the next one, where they count twice. As in the
+   KLL sketch of Karnin, Lang and Liberty, the top compactor holds k values
+   and every one below it two thirds of the one above, at least two. When
+   the top one overflows, a new one is put on top and the others shrink.
+   The memory per data point therefore stays below 3k values and two bytes
+   per compactor, however many sequences are added. While the single first
+   compactor is not full, it only takes as much memory as it holds values.
+
+   Up to k sequences, the median is exact. Beyond that, a compaction at the
+   level l moves the rank of the returned median by at most 2^l. For n
+   sequences and compactors of c values, the rank therefore differs from n/2
+   by at most the sum of n/c over all compactors but the top one, plus
+   2^l for every compactor of the level l that shrinks when a level is
+   added. NaN values are skipped, and only the data points that are present
+   in all sequences make it into the result. */
+
+namespace Cnv {
+
+class MedianSketch
+{
+public:
+
+	explicit MedianSketch(unsigned k=128);
+
+	void add(const Sequence& s);
+	Sequence median() const;
+
+	unsigned size() const { return samples; }
+
+private:
+
+	unsigned width(unsigned distance) const;
+	bool overflows(const Sequence& s, const std::vector<unsigned>& index) const;
+	void add_level();
+	void grow_first_level();
+
+	void insert(unsigned level, unsigned point, float value);
+	void insert_range(unsigned first, unsigned last, const Sequence* s,
+		const std::vector<unsigned>* index);
+	void median_range(unsigned first, unsigned last, float* out) const;
+
+	//	The compactors of all data points on one level, which hold up to width
+	//	values each and lie stride values apart. The count of every data point
+	//	has the offset of its next compaction in its top bit.
+	class Level
+	{
+	public:
+		std::vector<float> values;
+		std::vector<unsigned short> counts;
+		unsigned width;
+		unsigned stride;
+	};
+
+	void relayout_range(unsigned first, unsigned last,
+		std::vector<Level>* next);
+
+	unsigned capacity;
+	unsigned samples;
+	Sequence reference;
+	AlignmentPlan plan;
+	std::vector<Level> levels;
+	std::vector<bool> complete;
+};
+
+}
+
+#endif
@@ -20,6 +20,8 @@
 #include "CnvStringPool.hh"
 
 #include <string>
+#include <vector>
+#include <cstring>
 
 /* The StringPool class is used to reduce the memory footprint of
    noise-free-cnv. It ensures that several data sequences with the same data
@@ -27,22 +29,46 @@
    indentifiers seperately but only store pointers to the actual strings.
    There pointers are represented by the StringPointer class.
 
-   StringPool can be thought of as an optimized std::set<std::string>. */
+   The strings are copied into large arena blocks and found again through an
+   open addressing hash table. Every string receives a dense 32 bit id in the
+   order of insertion, so StringPointers from the same pool can be compared
+   and ordered with a single integer comparison. StringPointers from different
+   pools must not be mixed. A pool may be used by several threads at once. */
 
 namespace Cnv {
 
-StringPointer::StringPointer(): ptr(&null_ptr) {};
+StringPointer::StringPointer(): ptr(NULL) {};
 
-StringPointer::StringPointer(const std::string* s): ptr(s) {};
+StringPointer::StringPointer(const Entry* e): ptr(e) {};
 
-StringPointer::operator const std::string&() const { return *ptr; }
+StringPointer::operator std::string() const
+{
+	if(ptr!=NULL) return std::string(ptr->data, ptr->length);
+	else return std::string();
+}
 
-StringPointer::operator bool() const { return ptr!=&null_ptr; }
+StringPointer::operator bool() const { return ptr!=NULL; }
 
-bool StringPointer::operator<(const StringPointer& s) const
+unsigned StringPointer::id() const { return (ptr!=NULL)?ptr->id:0; }
+
+const char* StringPointer::c_str() const
+	{ return (ptr!=NULL)?ptr->data:""; }
+
+unsigned StringPointer::length() const
+	{ return (ptr!=NULL)?ptr->length:0; }
+
+//	Compares the underlying strings lexicographically like std::string.
+int StringPointer::compare(const StringPointer& s) const
 {
-	return s.ptr!=&null_ptr&&(ptr==&null_ptr||*ptr<*s.ptr);
-};
+	if(ptr==s.ptr) return 0;
+	unsigned l1=length(), l2=s.length();
+	int result=memcmp(c_str(), s.c_str(), (l1<l2)?l1:l2);
+	if(result!=0) return result;
+	else return (l1<l2)?-1:((l1>l2)?1:0);
+}
+
+bool StringPointer::operator<(const StringPointer& s) const
+	{ return id()<s.id(); };
 
 bool StringPointer::operator>(const StringPointer& s) const
 	{ return s<*this; };
@@ -54,22 +80,140 @@ bool StringPointer::operator>=(const StringPointer& s) const
 	{ return !(*this<s); }
 
 bool StringPointer::operator==(const StringPointer& s) const
-{
-	return ptr==s.ptr||(ptr!=&null_ptr&&s.ptr!=&null_ptr&&*ptr==*s.ptr);
+	{ return ptr==s.ptr; }
 
-}
 bool StringPointer::operator!=(const StringPointer& s) const
 	{ return !(*this==s); }
 
-std::string StringPointer::null_ptr="";
 
+StringPool::StringPool()
+	:table(1024, (const Entry*)NULL),block_used(0),block_size(0),
+	arena_bytes(0),string_bytes(0),count(0)
+	{}
+
+StringPool::~StringPool()
+{
+	std::vector<char*>::iterator it;
+	for(it=blocks.begin(); it!=blocks.end(); ++it) delete[] *it;
+}
+
+//	FNV-1a, folded to 32 bits. The identifiers are short, so this is cheaper
+//	than anything more elaborate.
+unsigned StringPool::hash(const char* s, unsigned length)
+{
+	unsigned long long h=14695981039346656037ULL;
+	for(unsigned i=0; i<length; ++i)
+	{
+		h^=(unsigned char)s[i];
+		h*=1099511628211ULL;
+	}
+	return (unsigned)(h^(h>>32));
+}
+
+StringPool::Entry* StringPool::allocate(unsigned length)
+{
+	size_t bytes=offsetof(Entry, data)+length+1;
+	bytes=(bytes+sizeof(unsigned)-1)/sizeof(unsigned)*sizeof(unsigned);
+
+	if(blocks.empty()||block_used+bytes>block_size)
+	{
+		size_t new_size=1<<20;
+		if(bytes>new_size) new_size=bytes;
+		blocks.push_back(new char[new_size]);
+		block_size=new_size;
+		arena_bytes+=new_size;
+		block_used=0;
+	}
+
+	Entry* e=(Entry*)(blocks.back()+block_used);
+	block_used+=bytes;
+	return e;
+}
+
+void StringPool::rehash(size_t new_size)
+{
+	std::vector<const Entry*> new_table(new_size, (const Entry*)NULL);
+
+	std::vector<const Entry*>::const_iterator it;
+	for(it=table.begin(); it!=table.end(); ++it)
+	{
+		if(*it==NULL) continue;
+		size_t slot=(*it)->hash&(new_size-1);
+		while(new_table[slot]!=NULL) slot=(slot+1)&(new_size-1);
+		new_table[slot]=*it;
+	}
+	table.swap(new_table);
+}
+
+//	Returns the slot that holds the string, or the empty slot where it belongs.
+size_t StringPool::find(const char* s, unsigned length, unsigned h) const
+{
+	size_t mask=table.size()-1;
+	size_t slot=h&mask;
+
+	while(table[slot]!=NULL)
+	{
+		const Entry* e=table[slot];
+		if(e->hash==h&&e->length==length&&memcmp(e->data, s, length)==0)
+			break;
+		slot=(slot+1)&mask;
+	}
+	return slot;
+}
+
+//	Strings that are already known are found under the reader lock, so that
+//	several threads loading files with the same data points do not wait for
+//	each other. Only new strings take the writer lock.
+StringPointer StringPool::operator()(const char* s, unsigned length)
+{
+	unsigned h=hash(s, length);
+
+	table_lock.reader_lock();
+	const Entry* found=table[find(s, length, h)];
+	table_lock.reader_unlock();
+	if(found!=NULL) return StringPointer(found);
+
+	table_lock.writer_lock();
+	size_t slot=find(s, length, h);
+	if(table[slot]!=NULL)
+	{
+		found=table[slot];
+		table_lock.writer_unlock();
+		return StringPointer(found);
+	}
+
+	Entry* e=allocate(length);
+	e->id=++count;
+	e->hash=h;
+	e->length=length;
+	memcpy(e->data, s, length);
+	e->data[length]='\0';
+	table[slot]=e;
+	string_bytes+=length;
+
+	if(2*count>table.size()) rehash(2*table.size());
+	table_lock.writer_unlock();
+
+	return StringPointer(e);
+}
 
 StringPointer StringPool::operator()(const std::string& s)
 {
-	float hash=0.0;
-	if(s.size()>=sizeof(float))
-		hash=*(float*)(s.c_str()+(s.size()-sizeof(float))/2);
-	StringPointer out(&*(data[hash].insert(s).first));
+	return (*this)(s.data(), s.size());
+}
+
+unsigned StringPool::size() const
+{
+	return count;
+}
+
+StringPool::Stats StringPool::stats() const
+{
+	Stats out;
+	out.strings=count;
+	out.string_bytes=string_bytes;
+	out.arena_bytes=arena_bytes;
+	out.table_bytes=table.size()*sizeof(const Entry*);
 	return out;
 }
 
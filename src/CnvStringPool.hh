@@ -20,8 +20,8 @@
 #ifndef _CNVSTRINGPOOL_
 #define _CNVSTRINGPOOL_
 #include <string>
-#include <set>
-#include <map>
+#include <vector>
+#include <cstddef>
 #include <glibmm.h>
 
 /* The StringPool class is used to reduce the memory footprint of
@@ -30,21 +30,30 @@
    indentifiers seperately but only store pointers to the actual strings.
    There pointers are represented by the StringPointer class.
 
-   StringPool can be thought of as an optimized std::set<std::string>. */
+   The strings are copied into large arena blocks and found again through an
+   open addressing hash table. Every string receives a dense 32 bit id in the
+   order of insertion, so StringPointers from the same pool can be compared
+   and ordered with a single integer comparison. StringPointers from different
+   pools must not be mixed. A pool may be used by several threads at once. */
 
 namespace Cnv {
 
-//	This class encapsules a pointer to a std::string.
+//	This class encapsules a pointer to a string stored in a StringPool.
 class StringPointer
 {
 public:
 	StringPointer();
-	StringPointer(const std::string* s);
 
-	operator const std::string&() const;
+	operator std::string() const;
 
 	operator bool() const;
 
+	unsigned id() const;
+	const char* c_str() const;
+	unsigned length() const;
+
+	int compare(const StringPointer& s) const;
+
 	bool operator<(const StringPointer& s) const;
 	bool operator>(const StringPointer& s) const;
 	bool operator<=(const StringPointer& s) const;
@@ -53,22 +62,68 @@ public:
 	bool operator!=(const StringPointer& s) const;
 
 private:
-	static std::string null_ptr;
-	const std::string* ptr;
+	friend class StringPool;
+
+	class Entry
+	{
+	public:
+		unsigned id;
+		unsigned hash;
+		unsigned length;
+		char data[4];
+	};
+
+	StringPointer(const Entry* e);
+
+	const Entry* ptr;
 };
 
-//	This class stores std::strings. It can be used to reduce memory
+//	This class stores strings. It can be used to reduce memory
 //	usage to avoid storing the same string multiple times.
 class StringPool
 {
 public:
+	class Stats
+	{
+	public:
+		unsigned strings;
+		size_t string_bytes;
+		size_t arena_bytes;
+		size_t table_bytes;
+	};
+
+	StringPool();
+	~StringPool();
+
 	StringPointer operator()(const std::string& s);
+	StringPointer operator()(const char* s, unsigned length);
+
+	unsigned size() const;
+	Stats stats() const;
 
 private:
-	std::map<float,std::set<std::string> > data;
+	StringPool(const StringPool&);
+	StringPool& operator=(const StringPool&);
+
+	typedef StringPointer::Entry Entry;
+
+	static unsigned hash(const char* s, unsigned length);
+
+	size_t find(const char* s, unsigned length, unsigned h) const;
+	Entry* allocate(unsigned length);
+	void rehash(size_t new_size);
+
+	std::vector<const Entry*> table;
+	std::vector<char*> blocks;
+	size_t block_used;
+	size_t block_size;
+	size_t arena_bytes;
+	size_t string_bytes;
+	unsigned count;
+
+	Glib::Threads::RWLock table_lock;
 };
 
 }
 
 #endif
-
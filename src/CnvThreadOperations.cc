@@ -23,6 +23,7 @@
 #include "CnvOperations.hh"
 #include "CnvLoadSave.hh"
 #include "PennCnvLoadSave.hh"
+#include "CnvCache.hh"
 
 #include <glibmm.h>
 #include <string>
@@ -34,15 +35,27 @@
 
 namespace Cnv { namespace Thread {
 
-void load_namesvalues_thread(Sequence out, std::string f, StringPool pool)
+//	Cnv::load in the form that Cnv::load_cached expects.
+std::vector<Cnv::Sequence> load_namesvalues_column(std::string f,
+	Cnv::StringPool& pool)
+{
+	return std::vector<Cnv::Sequence>(1, Cnv::load(f, pool));
+}
+
+//	With cache set, the files are opened through a binary cache next to them.
+void load_namesvalues_thread(Sequence out, std::string f, StringPool pool,
+	bool cache)
 {
 	out.writer_lock();
 	pool.writer_lock();
-	if(out!=NULL) *out=Cnv::load(f, *pool);
+	std::vector<Cnv::Sequence> out_seq=(cache)?
+		Cnv::load_cached(f, *pool, load_namesvalues_column, 1):
+		load_namesvalues_column(f, *pool);
+	if(out!=NULL&&out_seq.size()==1) *out=out_seq[0];
 	pool.writer_unlock();
 	out.writer_unlock();
 }
-Sequence load_namesvalues(std::string f, StringPool pool)
+Sequence load_namesvalues(std::string f, StringPool pool, bool cache)
 {
 	std::string name=f;
 	if(name.rfind('/')<name.size())
@@ -51,8 +64,8 @@ Sequence load_namesvalues(std::string f, StringPool pool)
 		name=name.substr(name.rfind('\\')+1, std::string::npos);
 
 	Sequence out(name);
-	Glib::Thread::create(sigc::bind(sigc::bind(sigc::bind(sigc::ptr_fun(
-		load_namesvalues_thread),pool),f),out), false);
+	Glib::Thread::create(sigc::bind(sigc::bind(sigc::bind(sigc::bind(
+		sigc::ptr_fun(load_namesvalues_thread),cache),pool),f),out), false);
 	return out;
 }
 
@@ -68,12 +81,15 @@ void save_namesvalues(const Sequence& in, std::string f)
 		save_namesvalues_thread),f),in), false);
 }
 
-void load_lrrbaf_thread(std::vector<Sequence> out, std::string f, StringPool pool)
+void load_lrrbaf_thread(std::vector<Sequence> out, std::string f, StringPool pool,
+	bool cache)
 {
 	if(out.size()==2)
 	{
 		pool.writer_lock();
-		std::vector<Cnv::Sequence> out_seq=PennCnv::load(f, *pool);
+		std::vector<Cnv::Sequence> out_seq=(cache)?
+			Cnv::load_cached(f, *pool, PennCnv::load, 2):
+			PennCnv::load(f, *pool);
 		pool.writer_unlock();
 		if(out_seq.size()==2)
 		{
@@ -86,7 +102,7 @@ void load_lrrbaf_thread(std::vector<Sequence> out, std::string f, StringPool poo
 		}
 	}
 }
-std::vector<Sequence> load_lrrbaf(std::string f, StringPool pool)
+std::vector<Sequence> load_lrrbaf(std::string f, StringPool pool, bool cache)
 {
 	std::string name=f;
 	if(name.rfind('/')<name.size())
@@ -97,8 +113,8 @@ std::vector<Sequence> load_lrrbaf(std::string f, StringPool pool)
 	std::vector<Sequence> out;
 	out.push_back(Sequence(name+" - LRR"));
 	out.push_back(Sequence(name+" - BAF"));
-	Glib::Thread::create(sigc::bind(sigc::bind(sigc::bind(sigc::ptr_fun(
-		load_lrrbaf_thread),pool),f),out), false);
+	Glib::Thread::create(sigc::bind(sigc::bind(sigc::bind(sigc::bind(
+		sigc::ptr_fun(load_lrrbaf_thread),cache),pool),f),out), false);
 	return out;
 }
 
@@ -256,6 +272,25 @@ Sequence blur(const Sequence& s, float p)
 	return out;
 }
 
+void recursive_blur_thread(Sequence out, Sequence in, float p)
+{
+	out.writer_lock();
+	in.reader_lock();
+	if(in!=NULL&&out!=NULL) *out=Cnv::blur(*in, p, Cnv::RecursiveBlur);
+	in.reader_unlock();
+	out.writer_unlock();
+}
+Sequence recursive_blur(const Sequence& s, float p)
+{
+	std::string value_string;
+	std::stringstream sstream; sstream<<p; sstream>>value_string;
+
+	Sequence out("recursive_blur( "+s.name+", "+value_string+" )");
+	Glib::Thread::create(sigc::bind(sigc::bind(sigc::bind(sigc::ptr_fun(
+		recursive_blur_thread),p),s),out), false);
+	return out;
+}
+
 void trunc_thread(Sequence out, Sequence in, float p)
 {
 	out.writer_lock();
@@ -528,6 +563,24 @@ Sequence sort(const Sequence& a, const Sequence& b)
 	return out;
 }
 
+void eliminate_dual_thread(Sequence out, Sequence a, Sequence b)
+{
+	out.writer_lock();
+	a.reader_lock();
+	b.reader_lock();
+	if(a!=NULL&&b!=NULL&&out!=NULL) *out=Cnv::eliminate(*a, *b);
+	b.reader_unlock();
+	a.reader_unlock();
+	out.writer_unlock();
+}
+Sequence eliminate(const Sequence& a, const Sequence& b)
+{
+	Sequence out("eliminate( "+a.name+", "+b.name+" )");
+	Glib::Thread::create(sigc::bind(sigc::bind(sigc::bind(sigc::ptr_fun(
+		eliminate_dual_thread),b),a),out), false);
+	return out;
+}
+
 void add_multi_thread(Sequence out, std::vector<Sequence> s)
 {
 	out.writer_lock();
@@ -30,11 +30,11 @@
 
 namespace Cnv { namespace Thread {
 
-Sequence 	load_namesvalues	(std::string, StringPool);
+Sequence 	load_namesvalues	(std::string, StringPool, bool);
 void		save_namesvalues	(const Sequence&, std::string);
 
 void		save_lrrbaf	(const std::vector<Sequence>&, std::string);
-std::vector<Sequence> 	load_lrrbaf(std::string, StringPool);
+std::vector<Sequence> 	load_lrrbaf(std::string, StringPool, bool);
 
 Sequence	add		(const Sequence&, float);
 Sequence	mul		(const Sequence&, float);
@@ -43,6 +43,7 @@ Sequence	div		(const Sequence&, float);
 Sequence	pow		(const Sequence&, float);
 Sequence	root	(const Sequence&, float);
 Sequence	blur	(const Sequence&, float);
+Sequence	recursive_blur	(const Sequence&, float);
 Sequence	trunc	(const Sequence&, float);
 Sequence	cut		(const Sequence&, float);
 Sequence	exp			(const Sequence&);
@@ -59,6 +60,7 @@ Sequence	mul			(const Sequence&, const Sequence&);
 Sequence	sub			(const Sequence&, const Sequence&);
 Sequence	div			(const Sequence&, const Sequence&);
 Sequence 	sort		(const Sequence&, const Sequence&);
+Sequence	eliminate	(const Sequence&, const Sequence&);
 Sequence	add			(const std::vector<Sequence>&);
 Sequence	arithmetic	(const std::vector<Sequence>&);
 Sequence	mul			(const std::vector<Sequence>&);
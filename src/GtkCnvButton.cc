@@ -46,7 +46,8 @@ void MenuItemOpen1::on_activate()
 		std::vector<std::string> filenames=openDialog.get_filenames();
 		std::vector<std::string>::iterator it;
 		for(it=filenames.begin(); it!=filenames.end(); ++it)
-			outline.add_object(function(*it, string_pool));
+			outline.add_object(function(*it, string_pool,
+				cache.get_active()));
 	}
 }
 
@@ -65,7 +66,8 @@ void MenuItemOpen2::on_activate()
 		std::vector<std::string> filenames=openDialog.get_filenames();
 		std::vector<std::string>::iterator it;
 		for(it=filenames.begin(); it!=filenames.end(); ++it)
-			outline.add_objects(function(*it, string_pool));
+			outline.add_objects(function(*it, string_pool,
+				cache.get_active()));
 	}
 }
 
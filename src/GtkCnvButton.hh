@@ -33,15 +33,17 @@ class MenuItemOpen1: public Gtk::MenuItem
 {
 public:
 	MenuItemOpen1(const Glib::ustring& s, Outline& o,
-		Cnv::Thread::StringPool sp, Cnv::Thread::Sequence(*f)
-			(std::string,Cnv::Thread::StringPool))
-		:Gtk::MenuItem(s),outline(o),string_pool(sp),function(f) {};
+		Cnv::Thread::StringPool sp, const Gtk::CheckMenuItem& c,
+		Cnv::Thread::Sequence(*f)
+			(std::string,Cnv::Thread::StringPool,bool))
+		:Gtk::MenuItem(s),outline(o),string_pool(sp),cache(c),function(f) {};
 
 private:
 	Outline& outline;
 	Cnv::Thread::StringPool string_pool;
+	const Gtk::CheckMenuItem& cache;
 	Cnv::Thread::Sequence(*function)
-		(std::string,Cnv::Thread::StringPool);
+		(std::string,Cnv::Thread::StringPool,bool);
 
 protected:
 	virtual void on_activate();
@@ -51,16 +53,17 @@ class MenuItemOpen2: public Gtk::MenuItem
 {
 public:
 	MenuItemOpen2(const Glib::ustring& s, Outline& o,
-		Cnv::Thread::StringPool sp,
+		Cnv::Thread::StringPool sp, const Gtk::CheckMenuItem& c,
 		std::vector<Cnv::Thread::Sequence>(*f)
-			(std::string,Cnv::Thread::StringPool))
-		:Gtk::MenuItem(s),outline(o),string_pool(sp),function(f) {};
+			(std::string,Cnv::Thread::StringPool,bool))
+		:Gtk::MenuItem(s),outline(o),string_pool(sp),cache(c),function(f) {};
 
 private:
 	Outline& outline;
 	Cnv::Thread::StringPool string_pool;
+	const Gtk::CheckMenuItem& cache;
 	std::vector<Cnv::Thread::Sequence>(*function)
-		(std::string,Cnv::Thread::StringPool);
+		(std::string,Cnv::Thread::StringPool,bool);
 
 protected:
 	virtual void on_activate();
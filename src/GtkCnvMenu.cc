@@ -30,17 +30,21 @@
 
 /* The Menu widget is used in the noise-free-cnv-gtk interface as the main menu.
    It consists of buttons to load and save data sequences, to show the "about"
-   dialogue and to remove data sequences from the catalogue. */
+   dialogue and to remove data sequences from the catalogue. The open menu
+   has a switch, off by default, to open files through a binary cache that is
+   kept next to them. */
 
 namespace GtkCnv {
 
 Menu::Menu(Outline& o): outline(o),
 	open_button(Gtk::Stock::OPEN), save_button(Gtk::Stock::SAVE),
 	close_button(Gtk::Stock::CLOSE), info_button(Gtk::Stock::INFO),
+	open_cache_item("keep binary cache"),
 	open_namesvalues_item("raw file format",
-		outline, string_pool, Cnv::Thread::load_namesvalues),
+		outline, string_pool, open_cache_item,
+		Cnv::Thread::load_namesvalues),
 	open_lrrbaf_item("PennCNV file format",
-		outline, string_pool, Cnv::Thread::load_lrrbaf),
+		outline, string_pool, open_cache_item, Cnv::Thread::load_lrrbaf),
 	save_namesvalues_item("raw file format",
 		outline, Cnv::Thread::save_namesvalues),
 	save_lrrbaf_item("PennCNV file format",
@@ -53,6 +57,8 @@ Menu::Menu(Outline& o): outline(o),
 
 	open_menu.append(open_namesvalues_item);
 	open_menu.append(open_lrrbaf_item);
+	open_menu.append(open_separator);
+	open_menu.append(open_cache_item);
 	save_menu.append(save_namesvalues_item);
 	save_menu.append(save_lrrbaf_item);
 
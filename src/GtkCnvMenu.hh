@@ -27,7 +27,9 @@
 
 /* The Menu widget is used in the noise-free-cnv-gtk interface as the main menu.
    It consists of buttons to load and save data sequences, to show the "about"
-   dialogue and to remove data sequences from the catalogue. */
+   dialogue and to remove data sequences from the catalogue. The open menu
+   has a switch, off by default, to open files through a binary cache that is
+   kept next to them. */
 
 namespace GtkCnv {
 
@@ -52,6 +54,8 @@ private:
 
 	Gtk::Menu open_menu;
 	Gtk::Menu save_menu;
+	Gtk::CheckMenuItem open_cache_item;
+	Gtk::SeparatorMenuItem open_separator;
 	MenuItemOpen1 open_namesvalues_item;
 	MenuItemOpen2 open_lrrbaf_item;
 	MenuItemSave1 save_namesvalues_item;
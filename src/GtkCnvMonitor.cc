@@ -38,32 +38,25 @@ void Monitor::Layer::compute_segments()
 {
 	if(object.reader_trylock()&&object!=NULL&&object->size()>0)
 	{
-		std::vector<Cnv::StringPointer> names=object->get_names();
+		const Cnv::Sequence& seq=*object;
 		std::vector<unsigned> int_segments;
 		int_segments.push_back(0);
-		int_segments.push_back(names.size()-1);
+		int_segments.push_back(seq.size()-1);
 
 		while(int_segments.size()<128)
 		{
 			bool redo=false;
 			for(unsigned i=0; i+1<int_segments.size(); i++)
 			{
-				std::string id1, chr1, pos1;
-				std::string id2, chr2, pos2;
-				std::string id_new, chr_new, pos_new;
-
-				Cnv::decompose_point_name(names[int_segments[i]],
-					id1, chr1, pos1);
-				Cnv::decompose_point_name(names[int_segments[i+1]],
-					id2, chr2, pos2);
+				unsigned char chr1=seq.chromosome(int_segments[i]);
+				unsigned char chr2=seq.chromosome(int_segments[i+1]);
 
 				if(int_segments[i+1]>int_segments[i]+1&&chr1!=chr2)
 				{
 					redo=true;
 					unsigned new_point=(int_segments[i]+int_segments[i+1])/2;
 
-					Cnv::decompose_point_name(names[new_point],
-						id_new, chr_new, pos_new);
+					unsigned char chr_new=seq.chromosome(new_point);
 
 					if(chr_new==chr1) int_segments[i]=new_point;
 					else if(chr_new==chr2) int_segments[i+1]=new_point;
@@ -81,7 +74,7 @@ void Monitor::Layer::compute_segments()
 		if(int_segments.size()<128)
 		{
 			for(unsigned i=0; i<int_segments.size(); i+=2)
-				segments.push_back((double)int_segments[i]/(double)(names.size()-1));
+				segments.push_back((double)int_segments[i]/(double)(seq.size()-1));
 		}
 		segments.push_back(1.0);
 
@@ -205,21 +198,15 @@ void Monitor::set_boundary(bool right_left,
 {
 	if(layers.size()!=0&&layers.front().object.reader_trylock())
 	{
-		const std::vector<Cnv::StringPointer>& identifiers=
-			layers.front().object->get_names();
+		const Cnv::Sequence& seq=*layers.front().object;
 
 		unsigned window_left=0;
-		unsigned window_right=identifiers.size()-1;
-
-		std::string id_left, id_right;
-		unsigned char chr_left, chr_right;
-		unsigned pos_left, pos_right;
-		Cnv::decompose_point_name(
-			(const std::string&)identifiers[window_left],
-			id_left, chr_left, pos_left);
-		Cnv::decompose_point_name(
-			(const std::string&)identifiers[window_right],
-			id_right, chr_right, pos_right);
+		unsigned window_right=seq.size()-1;
+
+		unsigned char chr_left=seq.chromosome(window_left);
+		unsigned char chr_right=seq.chromosome(window_right);
+		unsigned pos_left=seq.position(window_left);
+		unsigned pos_right=seq.position(window_right);
 
 		while(window_left+1<window_right)
 		{
@@ -233,25 +220,20 @@ void Monitor::set_boundary(bool right_left,
 				&&pos_right<pos)) return;
 			else
 			{
-				std::string id_center;
-				unsigned char chr_center;
-				unsigned pos_center;
-				decompose_point_name(
-					identifiers[window_left+(window_right-window_left)/2],
-					id_center, chr_center, pos_center);
+				unsigned center=window_left+(window_right-window_left)/2;
+				unsigned char chr_center=seq.chromosome(center);
+				unsigned pos_center=seq.position(center);
 
 				if(chr_center<chr||(chr_center==chr
 					&&pos_center<pos))
 				{
-					window_left+=(window_right-window_left)/2;
-					id_left=id_center;
+					window_left=center;
 					chr_left=chr_center;
 					pos_left=pos_center;
 				}
 				else
 				{
-					window_right=window_left+(window_right-window_left)/2;
-					id_right=id_center;
+					window_right=center;
 					chr_right=chr_center;
 					pos_right=pos_center;
 				}
@@ -259,9 +241,9 @@ void Monitor::set_boundary(bool right_left,
 		}
 
 		if(right_left) right=old_right=(double)(window_left-1)
-			/(double)(identifiers.size()-1);
+			/(double)(seq.size()-1);
 		else left=old_left=(double)(window_left-1)
-			/(double)(identifiers.size()-1);
+			/(double)(seq.size()-1);
 	}
 	if(buffer_surface) buffer_surface.clear();
 	if(!redraw_issued)
@@ -50,7 +50,7 @@ Panel::Panel(Outline& o): single(o),dual(o),multi(o),macro(o)
 }
 
 Panel::Single::Single(Outline& o):
-	Gtk::Table(2, 12, false),entry(),
+	Gtk::Table(2, 13, false),entry(),
 	add_button("add", o, entry, Cnv::Thread::add),
 	sub_button("sub", o, entry, Cnv::Thread::sub),
 	mul_button("mul", o, entry, Cnv::Thread::mul),
@@ -58,6 +58,7 @@ Panel::Single::Single(Outline& o):
 	pow_button("pow", o, entry, Cnv::Thread::pow),
 	root_button("root", o, entry, Cnv::Thread::root),
 	blur_button("blur", o, entry, Cnv::Thread::blur),
+	recursive_blur_button("iir blur", o, entry, Cnv::Thread::recursive_blur),
 	trunc_button("trunc", o, entry, Cnv::Thread::trunc),
 	cut_button("cut", o, entry, Cnv::Thread::cut),
 	exp_button("exp", o, Cnv::Thread::exp),
@@ -79,20 +80,21 @@ Panel::Single::Single(Outline& o):
 	attach(div_button, 1, 2, 1, 2);
 	attach(pow_button, 2, 3, 0, 1);
 	attach(root_button, 2, 3, 1, 2);
-	attach(entry, 3, 4, 0, 1);
+	attach(entry, 3, 5, 0, 1);
 	attach(blur_button, 3, 4, 1, 2);
-	attach(trunc_button, 4, 5, 0, 1);
-	attach(cut_button, 4, 5, 1, 2);
-	attach(separator, 5, 6, 0, 2);
-	attach(exp_button, 6, 7, 0, 1);
-	attach(log_button, 7, 8, 0, 1);
-	attach(erf_button, 8, 9, 0, 1);
-	attach(rank_button, 6, 9, 1, 2);
-	attach(abs_button, 9, 10, 0, 1);
-	attach(avg_button, 9, 10, 1, 2);
-	attach(sort_names_button, 10, 11, 0, 1);
-	attach(sort_values_button, 10, 11, 1, 2);
-	attach(stripXY_button, 11, 12, 0, 2);
+	attach(recursive_blur_button, 4, 5, 1, 2);
+	attach(trunc_button, 5, 6, 0, 1);
+	attach(cut_button, 5, 6, 1, 2);
+	attach(separator, 6, 7, 0, 2);
+	attach(exp_button, 7, 8, 0, 1);
+	attach(log_button, 8, 9, 0, 1);
+	attach(erf_button, 9, 10, 0, 1);
+	attach(rank_button, 7, 10, 1, 2);
+	attach(abs_button, 10, 11, 0, 1);
+	attach(avg_button, 10, 11, 1, 2);
+	attach(sort_names_button, 11, 12, 0, 1);
+	attach(sort_values_button, 11, 12, 1, 2);
+	attach(stripXY_button, 12, 13, 0, 2);
 }
 
 Panel::Dual::Dual(Outline& o):
@@ -144,7 +146,7 @@ Cnv::Thread::Sequence panel_macro_deviation(
 Cnv::Thread::Sequence panel_macro_eliminate(
 	const Cnv::Thread::Sequence& s, const Cnv::Thread::Sequence& t)
 {
-	return s-(t*(Cnv::Thread::avg(s*t)/Cnv::Thread::avg(t*t)));
+	return Cnv::Thread::eliminate(s, t);
 }
 
 Panel::Macro::Macro(Outline& o):
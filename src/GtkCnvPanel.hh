@@ -54,7 +54,8 @@ public:
 		Gtk::Entry entry;
 		Gtk::VSeparator separator;
 		ButtonSingle1 add_button, sub_button, mul_button, div_button,
-			pow_button, root_button, blur_button, trunc_button, cut_button;
+			pow_button, root_button, blur_button, recursive_blur_button,
+			trunc_button, cut_button;
 		ButtonSingle2 exp_button, log_button, erf_button, rank_button,
 			abs_button, avg_button, sort_names_button, sort_values_button,
 			stripXY_button;
@@ -22,38 +22,254 @@
 #include "CnvSequence.hh"
 #include "CnvStringPool.hh"
 #include "CnvEncodeDecode.hh"
+#include "CnvMappedFile.hh"
+#include "CnvOutputFile.hh"
+#include "CnvKernels.hh"
+#include <glibmm.h>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
+#include <cstring>
+#include <algorithm>
 
 /* This file implements the load and save functionality for data sequences
    in PennCNV files. The corresponding function for loading native files can be
    found in the PennCnvLoadSave.hh file.
 
    In addition to the filename, the load function receives a StringPool object
-   reference which it uses to minimize memory footprint. */
+   reference which it uses to minimize memory footprint. The file is mapped
+   into memory and its lines are parsed in parallel. The data points are
+   ordered by chromosome, position and name.
+
+   PennCNV signal files may hold the columns of many samples. load only reads
+   one of them, load_samples reads them all in the same pass and returns
+   sequences that share a single manifest. */
 
 namespace PennCnv {
 
-Point::Point(Cnv::StringPointer n, unsigned char c, unsigned p, float l, float b)
-	:name(n),chr(c),pos(p),lrr(l),baf(b)
-	{}
+namespace {
+
+//	Bytes per thread below which starting another thread does not pay.
+const size_t load_thread_bytes=1<<20;
+
+//	Characters whose separators are looked up at once.
+const unsigned separator_window=1<<16;
+
+//	Walks through the tabs and newlines of a piece of a file. They are found
+//	by Cnv::Kernel::separators a window at a time.
+class Separators
+{
+public:
+
+	Separators(const char* b, const char* e)
+		:window(b),window_end(b),end(e),offsets(separator_window),count(0),k(0)
+		{}
 
-bool Point::operator<(const Point& l) const
+	//	Returns the first tab or newline at or after p, or the end.
+	const char* next(const char* p)
+	{
+		for(;;)
+		{
+			while(k<count&&window+offsets[k]<p) k++;
+			if(k<count) return window+offsets[k];
+			if(window_end>=end) return end;
+
+			window=std::max(p, window_end);
+			unsigned n=std::min<size_t>(separator_window, end-window);
+			count=Cnv::Kernel::separators(window, n, &offsets[0]);
+			window_end=window+n;
+			k=0;
+		}
+	}
+
+private:
+
+	const char* window;
+	const char* window_end;
+	const char* end;
+	std::vector<unsigned> offsets;
+	unsigned count;
+	unsigned k;
+};
+
+//	The data points parsed from a piece of a file that begins at the start of
+//	a line. The columns are split like the header, at tabs and at a carriage
+//	return that ends the last column, and their blanks are trimmed. slots
+//	tells for every column whether it holds the name (0), the chromosome (1),
+//	the position (2) or the values of the sequence slot-3, or is ignored (-1).
+class LoadChunk
 {
-	return chr<l.chr||(chr==l.chr&&(pos<l.pos
-		||(pos==l.pos&&name<l.name)));
+public:
+
+	void parse(const char* i, const char* end, const std::vector<int>* slots,
+		Cnv::StringPool* pool)
+	{
+		Separators separators(i, end);
+		std::string id_long;
+		std::vector<const char*> column(3+values.size());
+		std::vector<const char*> column_end(3+values.size());
+
+		while(i<end)
+		{
+			std::fill(column.begin(), column.end(), i);
+			std::fill(column_end.begin(), column_end.end(), i);
+
+			const char* line_end=NULL;
+			const char* tab_start=i;
+			std::vector<int>::const_iterator it;
+			for(it=slots->begin(); it!=slots->end(); ++it)
+			{
+				const char* tab_end=(line_end==NULL)?
+					separators.next(tab_start):line_end;
+				if(tab_end==end||*tab_end=='\n')
+				{
+					line_end=tab_end;
+					const char* cr=(const char*)memchr(tab_start, '\r',
+						line_end-tab_start);
+					if(cr!=NULL) tab_end=cr;
+				}
+
+				if(*it>=0) { column[*it]=tab_start; column_end[*it]=tab_end; }
+
+				if(tab_end==line_end) tab_start=line_end;
+				else tab_start=tab_end+1;
+			}
+			while(line_end==NULL)
+			{
+				const char* s=separators.next(tab_start);
+				if(s==end||*s=='\n') line_end=s;
+				else tab_start=s+1;
+			}
+
+			for(unsigned c=0; c<column.size(); ++c)
+			{
+				while(column[c]<column_end[c]&&*column[c]==' ') column[c]++;
+				while(column[c]<column_end[c]&&column_end[c][-1]==' ')
+					column_end[c]--;
+			}
+
+			id_long.assign(column[0], column_end[0]);
+			id_long.push_back('/');
+			id_long.append(column[1], column_end[1]);
+			id_long.push_back('/');
+			id_long.append(column[2], column_end[2]);
+
+			names.push_back((*pool)(id_long.data(), id_long.size()));
+			chromosomes.push_back(Cnv::decode_chr(column[1], column_end[1]));
+			positions.push_back(Cnv::decode_pos(column[2], column_end[2]));
+			for(unsigned k=0; k<values.size(); ++k)
+				values[k].push_back(Cnv::decode_float_value(column[3+k],
+					column_end[3+k]));
+
+			i=line_end+1;
+		}
+	}
+
+	std::vector<Cnv::StringPointer> names;
+	std::vector<unsigned char> chromosomes;
+	std::vector<unsigned> positions;
+	std::vector<std::vector<float> > values;
+};
+
+//	Appends the columns of all chunks to those of the first one, releasing
+//	every chunk once it is copied.
+template<class T> void concatenate(std::vector<LoadChunk>& chunks,
+	std::vector<T> LoadChunk::*column, std::vector<T>& out)
+{
+	size_t total=0;
+	for(unsigned k=0; k<chunks.size(); ++k)
+		total+=(chunks[k].*column).size();
+
+	out.swap(chunks[0].*column);
+	out.reserve(total);
+	for(unsigned k=1; k<chunks.size(); ++k)
+	{
+		out.insert(out.end(), (chunks[k].*column).begin(),
+			(chunks[k].*column).end());
+		std::vector<T>().swap(chunks[k].*column);
+	}
 }
 
-std::vector<Cnv::Sequence> load(std::string f, Cnv::StringPool& pool)
+//	Reorders a column, releasing the old one.
+template<class T> void permute(std::vector<T>& column,
+	const std::vector<unsigned>& order)
 {
-	std::ifstream ifs(f.c_str());
+	std::vector<T> out(order.size());
+	for(size_t i=0; i<order.size(); ++i)
+		out[i]=column[order[i]];
+	column.swap(out);
+}
+
+class NameLess
+{
+public:
+	NameLess(const std::vector<Cnv::StringPointer>& n):names(n) {}
+	bool operator()(unsigned a, unsigned b) const
+		{ return names[a].compare(names[b])<0; }
+private:
+	const std::vector<Cnv::StringPointer>& names;
+};
+
+//	Returns the order of the data points by chromosome, position and name,
+//	or an empty vector if they are in that order already, as they are in
+//	most exported files. Otherwise the chromosome and position are packed
+//	into one key, which is sorted by bytes from the lowest one, skipping the
+//	bytes that are the same for all data points. Runs of equal keys are
+//	sorted by name. Data points that are equal in all three keep their
+//	order in the file.
+std::vector<unsigned> order(const std::vector<Cnv::StringPointer>& names,
+	const std::vector<unsigned char>& chromosomes,
+	const std::vector<unsigned>& positions)
+{
+	unsigned n=names.size();
+
+	std::vector<unsigned long long> keys(n);
+	for(unsigned i=0; i<n; ++i)
+		keys[i]=((unsigned long long)chromosomes[i]<<32)|positions[i];
+
+	bool sorted=true;
+	for(unsigned i=1; i<n&&sorted; ++i)
+		sorted=keys[i-1]<keys[i]||(keys[i-1]==keys[i]
+			&&names[i-1].compare(names[i])<=0);
+	if(sorted) return std::vector<unsigned>();
+
+	std::vector<unsigned> out(n), buffer(n);
+	for(unsigned i=0; i<n; ++i) out[i]=i;
+
+	for(unsigned shift=0; shift<40; shift+=8)
+	{
+		size_t count[257]={0};
+		for(unsigned i=0; i<n; ++i)
+			count[((keys[i]>>shift)&0xff)+1]++;
+		if(count[((keys[0]>>shift)&0xff)+1]==n) continue;
+
+		for(unsigned d=1; d<257; ++d) count[d]+=count[d-1];
+		for(unsigned i=0; i<n; ++i)
+			buffer[count[(keys[out[i]]>>shift)&0xff]++]=out[i];
+		out.swap(buffer);
+	}
+
+	std::vector<unsigned>().swap(buffer);
 
-	std::string tabCode;
+	for(unsigned first=0, last; first<n; first=last)
+	{
+		for(last=first+1; last<n&&keys[out[last]]==keys[out[first]]; ++last);
+		if(last-first>1) std::stable_sort(out.begin()+first, out.begin()+last,
+			NameLess(names));
+	}
+	return out;
+}
 
-	std::string line;
-	std::getline(ifs, line);
+//	Splits the first line of a file into its captions and returns the offset
+//	of the second line.
+size_t header(const Cnv::MappedFile& file, std::vector<std::string>& captions)
+{
+	const char* data=file.data();
+	const char* header_end=(file.size()>0)?
+		(const char*)memchr(data, '\n', file.size()):NULL;
+	if(header_end==NULL) header_end=data+file.size();
+	std::string line(data, header_end);
 
 	size_t tab_start=0;
 	while(tab_start<line.size())
@@ -62,120 +278,123 @@ std::vector<Cnv::Sequence> load(std::string f, Cnv::StringPool& pool)
 		if(tab_end>line.size()) tab_end=line.find('\r', tab_start);
 		if(tab_end>line.size()) tab_end=line.size();
 
-		std::string caption=line.substr(tab_start, tab_end-tab_start);
-		if(caption=="Name") tabCode.push_back('N');
-		else if(caption=="Chr") tabCode.push_back('C');
-		else if(caption=="Position") tabCode.push_back('P');
-		else if(caption.find(".Log R Ratio")<caption.size())
-			tabCode.push_back('L');
-		else if(caption.find(".B Allele Freq")<caption.size())
-			tabCode.push_back('B');
-		else tabCode.push_back(' ');
+		captions.push_back(line.substr(tab_start, tab_end-tab_start));
 
 		if(tab_end==line.size()) tab_start=line.size();
 		else tab_start=tab_end+1;
 	}
+	return std::min<size_t>(header_end-data+1, file.size());
+}
 
-	if(tabCode.find('N')<tabCode.size()
-		&&tabCode.find('C')<tabCode.size()
-		&&tabCode.find('P')<tabCode.size()
-		&&tabCode.find('L')<tabCode.size()
-		&&tabCode.find('B')<tabCode.size())
-	{
-		std::vector<Point> samples;
+//	Returns the slot of the name, chromosome and position columns, or -1.
+int probe_slot(const std::string& caption)
+{
+	if(caption=="Name") return 0;
+	else if(caption=="Chr") return 1;
+	else if(caption=="Position") return 2;
+	else return -1;
+}
 
-		while(std::getline(ifs, line))
+//	Parses the lines after the header, split into pieces that are parsed on
+//	one thread per processor and put together in order, and returns one
+//	sequence for each of the value slots. All of them share one manifest.
+std::vector<Cnv::Sequence> load_columns(const Cnv::MappedFile& file,
+	size_t rows, const std::vector<int>& slots, unsigned count,
+	Cnv::StringPool& pool)
+{
+	Glib::Timer timer;
+	const char* data=file.data();
+	std::vector<size_t> pieces=file.split(Glib::get_num_processors(),
+		load_thread_bytes);
+	pieces[0]=rows;
+
+	std::vector<LoadChunk> chunks(pieces.size()-1);
+	for(unsigned k=0; k<chunks.size(); ++k)
+		chunks[k].values.resize(count);
+
+	std::vector<Glib::Threads::Thread*> workers;
+	for(unsigned k=1; k<chunks.size(); ++k)
+		workers.push_back(Glib::Threads::Thread::create(sigc::bind(
+			sigc::mem_fun(chunks[k], &LoadChunk::parse),
+			data+pieces[k], data+pieces[k+1], &slots, &pool)));
+	chunks[0].parse(data+pieces[0], data+pieces[1], &slots, &pool);
+	for(unsigned k=0; k<workers.size(); ++k)
+		workers[k]->join();
+
+	std::vector<Cnv::StringPointer> names;
+	std::vector<unsigned char> chromosomes;
+	std::vector<unsigned> positions;
+	concatenate(chunks, &LoadChunk::names, names);
+	concatenate(chunks, &LoadChunk::chromosomes, chromosomes);
+	concatenate(chunks, &LoadChunk::positions, positions);
+
+	std::vector<std::vector<float> > values(count);
+	for(unsigned k=0; k<count; ++k)
+	{
+		values[k].reserve(names.size());
+		for(unsigned c=0; c<chunks.size(); ++c)
 		{
-			size_t id_start=0, id_size=0, chr_start=0, chr_size=0,
-				pos_start=0, pos_size=0, lrr_start=0, lrr_size=0,
-				baf_start=0, baf_size=0;
-
-			size_t tab_start=0;
-			std::string::iterator it;
-			for(it=tabCode.begin(); it!=tabCode.end(); ++it)
-			{
-				size_t tab_end=line.find('\t', tab_start);
-				if(tab_end>line.size()) tab_end=line.find('\r', tab_start);
-				if(tab_end>line.size()) tab_end=line.size();
-
-				if(*it=='N')
-					{ id_start=tab_start; id_size=tab_end-tab_start; }
-				else if(*it=='C')
-					{ chr_start=tab_start; chr_size=tab_end-tab_start; }
-				else if(*it=='P')
-					{ pos_start=tab_start; pos_size=tab_end-tab_start; }
-				else if(*it=='L')
-					{ lrr_start=tab_start; lrr_size=tab_end-tab_start; }
-				else if(*it=='B')
-					{ baf_start=tab_start; baf_size=tab_end-tab_start; }
-
-				if(tab_end==line.size()) tab_start=line.size();
-				else tab_start=tab_end+1;
-			}
-
-			while(id_size>0&&line[id_start]==' ')
-				{ id_start++; id_size--; }
-			while(id_size>0&&line[id_start+id_size-1]==' ')
-				id_size--;
-
-			while(chr_size>0&&line[chr_start]==' ')
-				{ chr_start++; chr_size--; }
-			while(chr_size>0&&line[chr_start+chr_size-1]==' ')
-				chr_size--;
-
-			while(pos_size>0&&line[pos_start]==' ')
-				{ pos_start++; pos_size--; }
-			while(pos_size>0&&line[pos_start+pos_size-1]==' ')
-				pos_size--;
-
-			while(lrr_size>0&&line[lrr_start]==' ')
-				{ lrr_start++; lrr_size--; }
-			while(lrr_size>0&&line[lrr_start+lrr_size-1]==' ')
-				lrr_size--;
-
-			while(baf_size>0&&line[baf_start]==' ')
-				{ baf_start++; baf_size--; }
-			while(baf_size>0&&line[baf_start+baf_size-1]==' ')
-				baf_size--;
-
-			std::string id_long;
-			id_long.resize(id_size+chr_size+pos_size+2);
-			for(size_t i=0; i<id_size; ++i)
-				id_long[i]=line[id_start+i];
-			for(size_t i=0; i<chr_size; ++i)
-				id_long[id_size+1+i]=line[chr_start+i];
-			for(size_t i=0; i<pos_size; ++i)
-				id_long[id_size+chr_size+2+i]=line[pos_start+i];
-			id_long[id_size]='/';
-			id_long[id_size+chr_size+1]='/';
-
-			samples.push_back(Point(pool(id_long),
-				Cnv::decode_chr(line.begin()+chr_start,
-					line.begin()+chr_start+chr_size),
-				Cnv::decode_pos(line.begin()+pos_start,
-					line.begin()+pos_start+pos_size),
-				Cnv::decode_float_value(line.begin()+lrr_start,
-					line.begin()+lrr_start+lrr_size),
-				Cnv::decode_float_value(line.begin()+baf_start,
-					line.begin()+baf_start+baf_size)));
+			values[k].insert(values[k].end(), chunks[c].values[k].begin(),
+				chunks[c].values[k].end());
+			std::vector<float>().swap(chunks[c].values[k]);
 		}
+	}
 
-		std::sort(samples.begin(), samples.end());
+	std::vector<unsigned> sorted=order(names, chromosomes, positions);
+	if(!sorted.empty())
+	{
+		permute(names, sorted);
+		permute(chromosomes, sorted);
+		permute(positions, sorted);
+		for(unsigned k=0; k<count; ++k)
+			permute(values[k], sorted);
+	}
+	std::vector<unsigned>().swap(sorted);
+
+	//	The columns become the manifest that all sequences share.
+	std::shared_ptr<Cnv::Sequence::Manifest> manifest(
+		new Cnv::Sequence::Manifest);
+	manifest->names.swap(names);
+	manifest->chromosomes.swap(chromosomes);
+	manifest->positions.swap(positions);
+
+	unsigned n=manifest->names.size();
+	std::vector<Cnv::Sequence> out;
+	for(unsigned k=0; k<count; ++k)
+	{
+		out.push_back(Cnv::Sequence(manifest));
+		std::copy(values[k].begin(), values[k].end(), out.back().extend(n));
+		std::vector<float>().swap(values[k]);
+	}
+	Cnv::add_load_stats(Cnv::LoadStats::parse, file.size(), timer.elapsed());
+	return out;
+}
 
-		std::vector<Cnv::Sequence> out;
-		out.resize(2);
+}
 
-		out[0].reserve(samples.size());
-		out[1].reserve(samples.size());
+//	If there are several log R ratio or B allele frequency columns, the last
+//	one of each is loaded.
+std::vector<Cnv::Sequence> load(std::string f, Cnv::StringPool& pool)
+{
+	Cnv::MappedFile file(f);
+	std::vector<std::string> captions;
+	size_t rows=header(file, captions);
 
-		std::vector<Point>::iterator it;
-		for(it=samples.begin(); it!=samples.end(); ++it)
-		{
-			out[0].push_back(it->name, it->lrr);
-			out[1].push_back(it->name, it->baf);
-		}
-		return out;
+	std::vector<int> slots(captions.size(), -1);
+	std::vector<bool> found(5, false);
+	for(unsigned c=0; c<captions.size(); ++c)
+	{
+		slots[c]=probe_slot(captions[c]);
+		if(slots[c]<0&&captions[c].find(".Log R Ratio")<captions[c].size())
+			slots[c]=3;
+		else if(slots[c]<0
+			&&captions[c].find(".B Allele Freq")<captions[c].size())
+			slots[c]=4;
+		if(slots[c]>=0) found[slots[c]]=true;
 	}
+
+	if(std::find(found.begin(), found.end(), false)==found.end())
+		return load_columns(file, rows, slots, 2, pool);
 	else
 	{
 		std::vector<Cnv::Sequence> dummy;
@@ -184,9 +403,60 @@ std::vector<Cnv::Sequence> load(std::string f, Cnv::StringPool& pool)
 	}
 }
 
+//	The log R ratio column of every sample is paired with the first B allele
+//	frequency column of the same sample that is not paired yet. Samples that
+//	lack one of the two are skipped.
+std::vector<Cnv::Sequence> load_samples(std::string f, Cnv::StringPool& pool,
+	std::vector<std::string>& samples)
+{
+	samples.clear();
+
+	Cnv::MappedFile file(f);
+	std::vector<std::string> captions;
+	size_t rows=header(file, captions);
+
+	std::vector<int> slots(captions.size(), -1);
+	std::vector<bool> found(3, false);
+	for(unsigned c=0; c<captions.size(); ++c)
+	{
+		slots[c]=probe_slot(captions[c]);
+		if(slots[c]>=0) found[slots[c]]=true;
+	}
+
+	for(unsigned c=0; c<captions.size(); ++c)
+	{
+		size_t lrr=captions[c].find(".Log R Ratio");
+		if(slots[c]>=0||lrr>=captions[c].size()) continue;
+
+		std::string sample=captions[c].substr(0, lrr);
+		for(unsigned d=0; d<captions.size(); ++d)
+			if(slots[d]<0&&captions[d].find(".Log R Ratio")>=captions[d].size()
+				&&captions[d].find(".B Allele Freq")==sample.size()
+				&&captions[d].compare(0, sample.size(), sample)==0)
+			{
+				slots[c]=3+2*samples.size();
+				slots[d]=4+2*samples.size();
+				samples.push_back(sample);
+				break;
+			}
+	}
+
+	if(std::find(found.begin(), found.end(), false)==found.end()
+		&&!samples.empty())
+		return load_columns(file, rows, slots, 2*samples.size(), pool);
+	else
+	{
+		samples.clear();
+		return std::vector<Cnv::Sequence>();
+	}
+}
+
+//	The identifier, chromosome and position are copied from the name of
+//	every data point as they are, and the values are formatted straight
+//	into the buffer of the file.
 void save(const std::vector<Cnv::Sequence>& o, std::string f)
 {
-	std::ofstream ofs(f.c_str());
+	Cnv::OutputFile file(f);
 	if(o.size()>=2)
 	{
 		std::string name=f;
@@ -194,18 +464,42 @@ void save(const std::vector<Cnv::Sequence>& o, std::string f)
 			name=name.substr(name.rfind('/')+1, std::string::npos);
 		if(name.rfind('\\')<name.size())
 			name=name.substr(name.rfind('\\')+1, std::string::npos);
+		if(name.size()>3&&name.compare(name.size()-3, 3, ".gz")==0)
+			name.erase(name.size()-3);
 
-		ofs<<"Name\tChr\tPosition\t"
-			<<name<<".Log R Ratio\t"<<name<<".B Allele Freq\r\n";
+		file.write("Name\tChr\tPosition\t"+name+".Log R Ratio\t"
+			+name+".B Allele Freq\r\n");
 
 		for(Cnv::SequenceDualIterator merge(o[0], o[1]); merge; ++merge)
 		{
-			std::string short_id, chr, pos;
-			Cnv::decompose_point_name(merge.name(), short_id, chr, pos);
-
-			ofs<<short_id<<"\t"<<chr<<"\t"<<pos<<"\t"
-				<<Cnv::encode_float_value(merge.first())<<"\t"
-				<<Cnv::encode_float_value(merge.second())<<"\r\n";
+			Cnv::StringPointer point=merge.name();
+			const char* n=point.c_str();
+			const char* end=n+point.length();
+
+			//	Split like decompose_point_name, the chromosome and position
+			//	are only there if the name has two slashes.
+			const char* id_end=(const char*)memchr(n, '/', end-n);
+			const char* chr_end=id_end?(const char*)memchr(id_end+1, '/',
+				end-id_end-1):NULL;
+
+			if(id_end) file.write(n, id_end-n);
+			file.write("\t", 1);
+			if(chr_end)
+			{
+				file.write(id_end+1, chr_end-id_end-1);
+				file.write("\t", 1);
+				file.write(chr_end+1, end-chr_end-1);
+			}
+			else file.write("\t", 1);
+
+			char* out=file.reserve(2*Cnv::float_value_chars+4);
+			*(out++)='\t';
+			out=Cnv::format_float_value(merge.first(), out);
+			*(out++)='\t';
+			out=Cnv::format_float_value(merge.second(), out);
+			*(out++)='\r';
+			*(out++)='\n';
+			file.commit(out);
 		}
 	}
 }
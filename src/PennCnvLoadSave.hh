@@ -28,26 +28,24 @@
    found in the PennCnvLoadSave.hh file.
 
    In addition to the filename, the load function receives a StringPool object
-   reference which it uses to minimize memory footprint. */
+   reference which it uses to minimize memory footprint. The file is mapped
+   into memory and its lines are parsed in parallel. The data points are
+   ordered by chromosome, position and name.
 
-namespace PennCnv {
-
-class Point
-{
-public:
-
-	Point(Cnv::StringPointer n, unsigned char c, unsigned p, float l, float b);
+   PennCNV signal files may hold the columns of many samples. load only reads
+   one of them, load_samples reads them all in the same pass and returns
+   sequences that share a single manifest. */
 
-	bool operator<(const Point& l) const;
-
-	Cnv::StringPointer name;
-	unsigned chr;
-	unsigned pos;
-	float lrr, baf;
-};
+namespace PennCnv {
 
 std::vector<Cnv::Sequence> load(std::string f, Cnv::StringPool& pool);
 
+//	Loads a file with the columns of several samples. The result holds the
+//	log R ratio and then the B allele frequency of every sample, in the order
+//	of the names that are stored in samples.
+std::vector<Cnv::Sequence> load_samples(std::string f, Cnv::StringPool& pool,
+	std::vector<std::string>& samples);
+
 void save(const std::vector<Cnv::Sequence>& o, std::string f);
 
 }
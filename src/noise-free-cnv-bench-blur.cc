@@ -0,0 +1,104 @@
+/*
+ *      noise-free-cnv-bench-blur.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvFourier.hh"
+#include <glibmm.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+/* This program shows what padding the transforms of Cnv::blur gains on the
+   lengths that are worst for FFTW, the primes. For the largest prime below a
+   few array sizes that are common after stripXY or cut, it times a forward
+   and backward transform of the prime length itself, which blur used to
+   transform, and of the length that blur now pads it to for the filter's
+   blur of 1000 points, reflected margins included. Plans are created before
+   the timing starts. It is built and run by "make bench". */
+
+namespace {
+
+const unsigned repeats=5;
+
+//	blur's margin on each side for the filter's blur of 1000 points, four
+//	standard deviations of the gaussian
+const unsigned margin=(unsigned)std::ceil(4.0*1000.0/(2.0*M_PI));
+
+bool is_prime(unsigned n)
+{
+	if(n<2) return false;
+	for(unsigned d=2; d<=n/d; d++)
+		if(n%d==0) return false;
+	return true;
+}
+
+//	Returns the best time of a forward and backward transform of length n.
+double measure(unsigned n)
+{
+	Cnv::Fourier::Transform plan(n);
+	Cnv::Fourier::RealBuffer real_buffer(n);
+	Cnv::Fourier::ComplexBuffer complex_buffer(n/2+1);
+	double* real=real_buffer.data();
+	fftw_complex* complex=complex_buffer.data();
+	if(!plan.valid()||real==NULL||complex==NULL) return NAN;
+
+	for(unsigned i=0; i<n; i++) real[i]=std::sin(0.001*i);
+
+	double best=HUGE_VAL;
+	for(unsigned r=0; r<repeats; r++)
+	{
+		Glib::Timer timer;
+		plan.forward(real, complex);
+		plan.backward(complex, real);
+		best=std::min(best, timer.elapsed());
+	}
+	return best;
+}
+
+}
+
+int main(int Args, char* Arg[])
+{
+	std::vector<unsigned> sizes;
+	for(int i=1; i<Args; i++) sizes.push_back(atoi(Arg[i]));
+	if(sizes.empty())
+	{
+		sizes.push_back(100000);
+		sizes.push_back(300000);
+		sizes.push_back(600000);
+		sizes.push_back(1000000);
+		sizes.push_back(2000000);
+	}
+
+	std::cout<<"length\tseconds\tpadded\tseconds\tspeedup"<<std::endl;
+	for(unsigned k=0; k<sizes.size(); k++)
+	{
+		unsigned n=sizes[k];
+		while(n>2&&!is_prime(n)) n--;
+		unsigned padded=Cnv::Fourier::smooth_length(n+2*margin);
+
+		double before=measure(n);
+		double after=measure(padded);
+		std::cout<<n<<"\t"<<std::setprecision(4)<<before<<"\t"
+			<<padded<<"\t"<<after<<"\t"<<before/after<<std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ *      noise-free-cnv-bench-float.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvEncodeDecode.hh"
+#include <glibmm.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+/* This program measures how fast values in the notation of PennCNV files,
+   four decimals around zero, are read by Cnv::decode_float_value and by
+   strtof and written by Cnv::format_float_value and by snprintf. Each is
+   timed several times and the best time is reported. It is built and run by
+   "make bench". */
+
+namespace {
+
+const unsigned repeats=9;
+
+std::string text;
+std::vector<size_t> offsets;
+std::vector<float> values;
+
+double decode_fast()
+{
+	double sum=0.0;
+	for(size_t k=0; k+1<offsets.size(); ++k)
+		sum+=Cnv::decode_float_value(text.data()+offsets[k],
+			text.data()+offsets[k+1]-1);
+	return sum;
+}
+
+double decode_strtof()
+{
+	double sum=0.0;
+	for(size_t k=0; k+1<offsets.size(); ++k)
+		sum+=strtof(text.c_str()+offsets[k], NULL);
+	return sum;
+}
+
+double format_fast()
+{
+	double sum=0.0;
+	char out[Cnv::float_value_chars];
+	for(size_t k=0; k<values.size(); ++k)
+		sum+=Cnv::format_float_value(values[k], out)-out;
+	return sum;
+}
+
+double format_snprintf()
+{
+	double sum=0.0;
+	char out[Cnv::float_value_chars];
+	for(size_t k=0; k<values.size(); ++k)
+		sum+=snprintf(out, sizeof(out), "%.4f", values[k]);
+	return sum;
+}
+
+void measure(const char* name, double (*run)())
+{
+	double best=HUGE_VAL, sum=0.0;
+	for(unsigned r=0; r<repeats; ++r)
+	{
+		Glib::Timer timer;
+		sum+=run();
+		best=std::min(best, timer.elapsed());
+	}
+	std::cout<<name<<": "<<values.size()/best/1e6<<" M values/s"
+		<<" (checksum "<<sum<<")"<<std::endl;
+}
+
+}
+
+int main(int Args, char* Arg[])
+{
+	unsigned n=(Args>1)?atoi(Arg[1]):2000000;
+
+	//	Sums of uniform numbers are close enough to the normal distribution
+	//	of log R ratios.
+	srand(1);
+	char buffer[32];
+	for(unsigned k=0; k<n; ++k)
+	{
+		double v=-0.6;
+		for(unsigned j=0; j<4; ++j) v+=0.3*rand()/(double)RAND_MAX;
+		values.push_back((float)v);
+		offsets.push_back(text.size());
+		snprintf(buffer, sizeof(buffer), "%.4f\t", v);
+		text+=buffer;
+	}
+	offsets.push_back(text.size());
+
+	measure("decode_float_value", decode_fast);
+	measure("strtof", decode_strtof);
+	measure("format_float_value", format_fast);
+	measure("snprintf", format_snprintf);
+	return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ *      noise-free-cnv-check-float.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CnvEncodeDecode.hh"
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+/* This program checks Cnv::decode_float_value against strtof on random
+   numbers in many notations, on the midpoints between neighbouring floats,
+   where correct rounding matters most, and on random strings of digits. Every
+   string that strtof reads completely must give the same float. It also
+   checks that Cnv::format_float_value writes numbers that read back to
+   within half of the last decimal. It is built and run by "make check". */
+
+namespace {
+
+unsigned long long state=88172645463325252ULL;
+unsigned long failures=0, checks=0;
+
+unsigned long long random_bits()
+{
+	state^=state<<13;
+	state^=state>>7;
+	state^=state<<17;
+	return state;
+}
+
+float random_float()
+{
+	float f;
+	do
+	{
+		unsigned u=(unsigned)random_bits();
+		memcpy(&f, &u, sizeof(f));
+	} while(std::isnan(f));
+	return f;
+}
+
+void fail(const std::string& s, float got, float want)
+{
+	if(++failures<=20)
+		std::cout<<"'"<<s<<"' gives "<<got<<" instead of "<<want<<std::endl;
+}
+
+void check_decode(const std::string& s)
+{
+	char* end;
+	float want=strtof(s.c_str(), &end);
+	if(s.empty()||end!=s.c_str()+s.size()) return;
+
+	++checks;
+	float got=Cnv::decode_float_value(s.data(), s.data()+s.size());
+	if(std::isnan(got)&&std::isnan(want)) return;
+	if(memcmp(&got, &want, sizeof(float))!=0) fail(s, got, want);
+}
+
+void check_format(float v)
+{
+	char out[Cnv::float_value_chars];
+	std::string s(out, Cnv::format_float_value(v, out));
+	++checks;
+	float got=Cnv::decode_float_value(s);
+	if(std::isnan(v)||std::isinf(v))
+	{
+		if(!std::isnan(got)) fail(s, got, v);
+	}
+	else if(fabs((double)got-(double)v)>0.00005+fabs((double)v)*1e-7)
+		fail(s, got, v);
+}
+
+}
+
+int main(int Args, char* Arg[])
+{
+	unsigned rounds=(Args>1)?atoi(Arg[1]):1000000;
+	const char* formats[]={"%.9g", "%.8g", "%.7g", "%.6e", "%.20g", "%.12e",
+		"%.3f", "%.45f", "%.1e", "%.4f"};
+	const unsigned n_formats=sizeof(formats)/sizeof(formats[0]);
+	char buffer[512];
+
+	for(unsigned k=0; k<rounds; ++k)
+	{
+		float f=random_float();
+		snprintf(buffer, sizeof(buffer), formats[k%n_formats], f);
+		check_decode(buffer);
+
+		float g=random_float();
+		if(!std::isinf(g))
+		{
+			double mid=((double)g+(double)nextafterf(g, INFINITY))/2.0;
+			snprintf(buffer, sizeof(buffer), "%.70g", mid);
+			check_decode(buffer);
+			snprintf(buffer, sizeof(buffer), "%.17g", mid);
+			check_decode(buffer);
+		}
+
+		std::string s;
+		if(random_bits()%2) s+='-';
+		unsigned length=1+random_bits()%40, dot=random_bits()%(length+1);
+		for(unsigned j=0; j<length; ++j)
+		{
+			if(j==dot) s+='.';
+			s+=(char)('0'+random_bits()%10);
+		}
+		if(random_bits()%2)
+		{
+			snprintf(buffer, sizeof(buffer), "e%d", (int)(random_bits()%120)-70);
+			s+=buffer;
+		}
+		check_decode(s);
+
+		check_format(f);
+		check_format((float)((int)(random_bits()%200000)-100000)/10000.0f);
+	}
+
+	const char* special[]={"nan", "NaN", "-inf", "Infinity", "+1e5", ".5", "5.",
+		"0", "-0", "1e-46", "1e-45", "7e-46", "3.4028235e38", "3.4028236e38",
+		"3.40282357e38", "1e39", "1.17549435e-38", "16777217", "16777216.5",
+		"0.000000000000000000000000000000000000000000001401298464324817",
+		"123456789012345678901234567890"};
+	for(unsigned k=0; k<sizeof(special)/sizeof(special[0]); ++k)
+		check_decode(special[k]);
+
+	std::cout<<checks<<" checks, "<<failures<<" failures"<<std::endl;
+	return (failures==0)?0:1;
+}
@@ -0,0 +1,188 @@
+/*
+ *      noise-free-cnv-check-samples.cc - this file is part of noise-free-cnv.
+ *
+ *      Copyright 2010-2013 Philip Ginsbach <philip.develop@gmail.com>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PennCnvLoadSave.hh"
+#include "CnvSequence.hh"
+#include "CnvStringPool.hh"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+/* This program checks PennCnv::load_samples against PennCnv::load. It writes
+   random PennCNV files with several samples, whose columns are in random
+   order, and for every sample a file with only its columns. Every sample
+   that load_samples reads from the whole file must have the same names,
+   chromosomes, positions and values as load reads from the file of the
+   sample alone. It is built and run by "make check". */
+
+namespace {
+
+unsigned long long state=88172645463325252ULL;
+unsigned long failures=0, checks=0;
+
+unsigned long long random_bits()
+{
+	state^=state<<13;
+	state^=state>>7;
+	state^=state<<17;
+	return state;
+}
+
+void fail(const std::string& what, unsigned round, const std::string& sample)
+{
+	if(++failures<=20)
+		std::cout<<"round "<<round<<", sample '"<<sample<<"': "
+			<<what<<std::endl;
+}
+
+//	Writes text to a new temporary file and returns its name.
+std::string write_file(const std::string& text)
+{
+	char name[]="/tmp/noise-free-cnv-check-XXXXXX";
+	int fd=mkstemp(name);
+	if(fd<0) return std::string();
+	std::FILE* file=fdopen(fd, "w");
+	std::fwrite(text.data(), 1, text.size(), file);
+	std::fclose(file);
+	return name;
+}
+
+std::string random_value()
+{
+	char buffer[32];
+	if(random_bits()%50==0) return "NaN";
+	snprintf(buffer, sizeof(buffer), "%.4f",
+		(double)(random_bits()%20001)/10000.0-1.0);
+	return buffer;
+}
+
+bool same_values(const Cnv::Sequence& s, const Cnv::Sequence& t)
+{
+	return s.size()==t.size()&&memcmp(s.get_values().data(),
+		t.get_values().data(), s.size()*sizeof(float))==0;
+}
+
+void check_round(unsigned round)
+{
+	unsigned n_samples=1+random_bits()%6;
+	unsigned n_rows=random_bits()%3000;
+
+	//	The columns of the probes, the pairs of columns of every sample in
+	//	the order of the samples, each pair in random order, and sometimes a
+	//	genotype column that is ignored.
+	std::vector<std::string> captions, sample_names;
+	std::vector<int> kinds;
+	for(unsigned k=0; k<n_samples; k++)
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "sample%u", k);
+		sample_names.push_back(buffer);
+		bool swap=random_bits()%2;
+		kinds.push_back(3+2*k+swap);
+		kinds.push_back(3+2*k+!swap);
+		if(random_bits()%3==0) kinds.push_back(-1);
+	}
+	for(int c=0; c<3; c++)
+		kinds.insert(kinds.begin()+random_bits()%(kinds.size()+1), c);
+
+	const char* probe_captions[]={"Name", "Chr", "Position"};
+	for(unsigned c=0; c<kinds.size(); c++)
+	{
+		if(kinds[c]<0) captions.push_back("sample.GType");
+		else if(kinds[c]<3) captions.push_back(probe_captions[kinds[c]]);
+		else captions.push_back(sample_names[(kinds[c]-3)/2]
+			+(((kinds[c]-3)%2==0)?".Log R Ratio":".B Allele Freq"));
+	}
+
+	std::vector<std::string> whole(1), single(n_samples);
+	for(unsigned c=0; c<kinds.size(); c++)
+		whole[0]+=captions[c]+((c+1<kinds.size())?"\t":"\r\n");
+	for(unsigned k=0; k<n_samples; k++)
+		single[k]="Name\tChr\tPosition\t"+sample_names[k]+".Log R Ratio\t"
+			+sample_names[k]+".B Allele Freq\r\n";
+
+	const char* chromosomes[]={"1", "2", "3", "7", "12", "22", "X", "Y"};
+	for(unsigned i=0; i<n_rows; i++)
+	{
+		std::vector<std::string> fields(3+2*n_samples);
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "rs%u", i);
+		fields[0]=buffer;
+		fields[1]=chromosomes[random_bits()%8];
+		snprintf(buffer, sizeof(buffer), "%u",
+			(unsigned)(random_bits()%100000000));
+		fields[2]=buffer;
+		for(unsigned k=0; k<2*n_samples; k++) fields[3+k]=random_value();
+
+		for(unsigned c=0; c<kinds.size(); c++)
+			whole[0]+=((kinds[c]<0)?std::string("AB"):fields[kinds[c]])
+				+((c+1<kinds.size())?"\t":"\r\n");
+		for(unsigned k=0; k<n_samples; k++)
+			single[k]+=fields[0]+"\t"+fields[1]+"\t"+fields[2]+"\t"
+				+fields[3+2*k]+"\t"+fields[4+2*k]+"\r\n";
+	}
+
+	Cnv::StringPool pool;
+	std::string whole_name=write_file(whole[0]);
+	std::vector<std::string> samples;
+	std::vector<Cnv::Sequence> all=
+		PennCnv::load_samples(whole_name, pool, samples);
+	unlink(whole_name.c_str());
+
+	++checks;
+	if(samples!=sample_names||all.size()!=2*n_samples)
+	{
+		fail("samples are not found", round, "");
+		return;
+	}
+
+	for(unsigned k=0; k<n_samples; k++)
+	{
+		std::string single_name=write_file(single[k]);
+		std::vector<Cnv::Sequence> pair=PennCnv::load(single_name, pool);
+		unlink(single_name.c_str());
+
+		++checks;
+		if(pair.size()!=2) fail("load fails", round, samples[k]);
+		else if(all[2*k].get_names()!=pair[0].get_names()
+			||all[2*k].get_chromosomes()!=pair[0].get_chromosomes()
+			||all[2*k].get_positions()!=pair[0].get_positions())
+			fail("data points differ", round, samples[k]);
+		else if(!same_values(all[2*k], pair[0]))
+			fail("log R ratios differ", round, samples[k]);
+		else if(!same_values(all[2*k+1], pair[1]))
+			fail("B allele frequencies differ", round, samples[k]);
+	}
+}
+
+}
+
+int main(int Args, char* Arg[])
+{
+	unsigned rounds=(Args>1)?atoi(Arg[1]):200;
+	for(unsigned r=0; r<rounds; r++) check_round(r);
+
+	std::cout<<checks<<" checks, "<<failures<<" failures"<<std::endl;
+	return (failures==0)?0:1;
+}
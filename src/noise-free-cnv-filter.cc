@@ -19,12 +19,22 @@
 
 #include "GtkCnvInterface.hh"
 #include "CnvOperations.hh"
+#include "CnvExpression.hh"
+#include "CnvReductions.hh"
+#include "CnvFourier.hh"
+#include "CnvSketch.hh"
+#include "CnvCache.hh"
+#include "CnvMappedFile.hh"
 #include "CnvLoadSave.hh"
 #include "PennCnvLoadSave.hh"
 #include "CnvEncodeDecode.hh"
 #include <gtkmm.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
 #include "CnvCalling.hh"
 
 #if !(defined(NFCNV_VERSION_MAJOR)&&defined(NFCNV_VERSION_MINOR))
@@ -43,10 +53,7 @@ Cnv::Sequence normalize_sequence(const Cnv::Sequence& s, double& x_chr)
 	unsigned autosome_divisor=0, gonosome_divisor=0;
 	for(Cnv::SequenceSingleIterator iter(s); iter; ++iter)
 	{
-		std::string id;
-		unsigned char chr;
-		unsigned pos;
-		Cnv::decompose_point_name(iter.name(), id, chr, pos);
+		unsigned char chr=iter.chromosome();
 
 		if(chr<251&&!std::isnan(iter.value())&&!std::isinf(iter.value()))
 		{
@@ -65,15 +72,12 @@ Cnv::Sequence normalize_sequence(const Cnv::Sequence& s, double& x_chr)
 	Cnv::Sequence new_sequence;
 	for(Cnv::SequenceSingleIterator iter(s); iter; ++iter)
 	{
-		std::string id;
-		unsigned char chr;
-		unsigned pos;
-		Cnv::decompose_point_name(iter.name(), id, chr, pos);
-
-		if(chr<251) new_sequence.push_back(
-			iter.name(), iter.value()-autosome_average);
-		else if(chr==251) new_sequence.push_back(
-			iter.name(), iter.value()-gonosome_average);
+		unsigned char chr=iter.chromosome();
+
+		if(chr<251) new_sequence.push_back(iter.name(),
+			iter.value()-autosome_average, chr, iter.position());
+		else if(chr==251) new_sequence.push_back(iter.name(),
+			iter.value()-gonosome_average, chr, iter.position());
 	}
 	x_chr=gonosome_average;
 	return new_sequence;
@@ -81,26 +85,473 @@ Cnv::Sequence normalize_sequence(const Cnv::Sequence& s, double& x_chr)
 
 Cnv::Sequence unnormalize_x_chromo(const Cnv::Sequence& s, double x_chr)
 {
-	Cnv::Sequence new_sequence;
+	Cnv::Sequence new_sequence(s.get_manifest());
+	new_sequence.reserve(s.size());
 	for(Cnv::SequenceSingleIterator iter(s); iter; ++iter)
 	{
-		std::string id;
-		unsigned char chr;
-		unsigned pos;
-		Cnv::decompose_point_name(iter.name(), id, chr, pos);
-
-		if(chr==251) new_sequence.push_back(
-			iter.name(), iter.value()+x_chr);
-		else new_sequence.push_back(iter.name(), iter.value());
+		unsigned char chr=iter.chromosome();
+
+		if(chr==251) new_sequence.push_back(iter.name(),
+			iter.value()+x_chr, chr, iter.position());
+		else new_sequence.push_back(iter.name(),
+			iter.value(), chr, iter.position());
 	}
 	return new_sequence;
 }
 
+// Keeps the normalized and blurred data of every file from the computation of
+// the profiles until they are applied. The values are written to a temporary
+// file and read back in the same order, while the manifests stay in memory
+// and are shared between files with the same data points. If no temporary
+// file can be created, the sequences are kept in memory instead.
+class Spill
+{
+public:
+
+	Spill():file(std::tmpfile()),next(0) {}
+	~Spill() { if(file!=NULL) std::fclose(file); }
+
+	void put(const Cnv::Sequence& whole, const Cnv::Sequence& low,
+		const Cnv::Sequence& baf, double x_chr)
+	{
+		x_chrs.push_back(x_chr);
+		if(file==NULL)
+		{
+			sequences.push_back(whole);
+			sequences.push_back(low);
+			sequences.push_back(baf);
+		}
+		else
+		{
+			write(whole);
+			write(low);
+			write(baf);
+		}
+	}
+
+	void get(Cnv::Sequence& whole, Cnv::Sequence& low,
+		Cnv::Sequence& baf, double& x_chr)
+	{
+		if(next==0&&file!=NULL) std::rewind(file);
+		x_chr=x_chrs[next];
+		if(file==NULL)
+		{
+			whole=sequences[3*next];
+			low=sequences[3*next+1];
+			baf=sequences[3*next+2];
+		}
+		else
+		{
+			whole=read(3*next);
+			low=read(3*next+1);
+			baf=read(3*next+2);
+		}
+		next++;
+	}
+
+private:
+
+	void write(const Cnv::Sequence& s)
+	{
+		Cnv::Sequence::ManifestPointer m=s.get_manifest();
+		for(unsigned k=0; m&&k<manifests.size(); k++)
+			if(manifests[k]==m||(manifests[k]&&manifests[k]->names==m->names
+				&&manifests[k]->chromosomes==m->chromosomes
+				&&manifests[k]->positions==m->positions))
+			{
+				m=manifests[k];
+				break;
+			}
+		if(m&&std::find(manifests.begin(), manifests.end(), m)==manifests.end())
+			manifests.push_back(m);
+
+		shared.push_back(m);
+		sizes.push_back(s.size());
+		std::fwrite(s.get_values().data(), sizeof(Cnv::Sequence::value_type),
+			s.size(), file);
+	}
+
+	Cnv::Sequence read(unsigned k)
+	{
+		Cnv::Sequence s(shared[k]);
+		if(std::fread(s.extend(sizes[k]), sizeof(Cnv::Sequence::value_type),
+			sizes[k], file)!=sizes[k]) return Cnv::Sequence();
+		return s;
+	}
+
+	std::FILE* file;
+	unsigned next;
+	std::vector<double> x_chrs;
+	std::vector<Cnv::Sequence> sequences;
+	std::vector<Cnv::Sequence::ManifestPointer> manifests;
+	std::vector<Cnv::Sequence::ManifestPointer> shared;
+	std::vector<unsigned> sizes;
+};
+
+// A step of the filter that is performed for every file. prepare and finish
+// are called in the order of the files, prepare for one file at a time and
+// finish on the thread that started the pool. process may run for several
+// files at once, whatever it writes to out is printed in the order of the
+// files as well. finish is given the files from first to last together,
+// those that were in flight at the same time, and by default finishes them
+// one after another.
+class FileStage
+{
+public:
+
+	virtual ~FileStage() {}
+
+	virtual void prepare(unsigned) {}
+	virtual void process(unsigned i, std::ostream& out)=0;
+	virtual void finish(unsigned) {}
+
+	virtual void finish(unsigned first, unsigned last)
+	{
+		for(unsigned i=first; i<last; i++) finish(i);
+	}
+};
+
+// Runs a stage over all files on a bounded number of threads. A file is only
+// started while fewer than two files per thread are in flight and the costs
+// of the files in flight, its own included, stay within the budget. A file
+// is in flight from prepare until its finish has returned. The next file is
+// always started if no other one is in flight, so a file that is larger than
+// the whole budget is processed on its own. A budget of 0 means no limit.
+// Once the oldest file is processed, all files that have been started by
+// then are awaited and finished together.
+class FilePool
+{
+public:
+
+	FilePool(unsigned j, unsigned long long b):jobs(std::max(1u, j)),budget(b) {}
+
+	void run(FileStage& s, const std::vector<unsigned long long>& c)
+	{
+		stage=&s; costs=&c;
+		next=0; in_flight=0; reserved=0;
+		outputs.assign(c.size(), std::string());
+		done.assign(c.size(), false);
+
+		std::vector<Glib::Threads::Thread*> workers;
+		for(unsigned t=0; t<std::min<size_t>(jobs, c.size()); t++)
+			workers.push_back(Glib::Threads::Thread::create(
+				sigc::mem_fun(*this, &FilePool::work)));
+
+		mutex.lock();
+		for(unsigned first=0; first<c.size(); )
+		{
+			while(!done[first]) cond.wait(mutex);
+			unsigned last=next;
+			for(unsigned i=first; i<last; i++)
+			{
+				while(!done[i]) cond.wait(mutex);
+				std::string out;
+				out.swap(outputs[i]);
+				mutex.unlock();
+
+				std::cout<<out;
+				std::cout.flush();
+
+				mutex.lock();
+			}
+			mutex.unlock();
+
+			stage->finish(first, last);
+
+			mutex.lock();
+			for(unsigned i=first; i<last; i++)
+			{
+				in_flight--;
+				reserved-=c[i];
+			}
+			first=last;
+			cond.broadcast();
+		}
+		mutex.unlock();
+
+		for(unsigned t=0; t<workers.size(); t++)
+			workers[t]->join();
+	}
+
+private:
+
+	bool blocked() const
+	{
+		return in_flight>0&&(in_flight>=2*jobs
+			||(budget>0&&reserved+(*costs)[next]>budget));
+	}
+
+	void work()
+	{
+		mutex.lock();
+		for(;;)
+		{
+			while(next<costs->size()&&blocked()) cond.wait(mutex);
+			if(next>=costs->size()) break;
+
+			unsigned i=next++;
+			in_flight++;
+			reserved+=(*costs)[i];
+			stage->prepare(i);
+			mutex.unlock();
+
+			std::ostringstream out;
+			stage->process(i, out);
+
+			mutex.lock();
+			outputs[i]=out.str();
+			done[i]=true;
+			cond.broadcast();
+		}
+		mutex.unlock();
+	}
+
+	unsigned jobs;
+	unsigned long long budget;
+
+	FileStage* stage;
+	const std::vector<unsigned long long>* costs;
+	unsigned next;
+	unsigned in_flight;
+	unsigned long long reserved;
+	std::vector<std::string> outputs;
+	std::vector<bool> done;
+
+	Glib::Threads::Mutex mutex;
+	Glib::Threads::Cond cond;
+};
+
+// The name of the filtered file of a sample. Files with a single sample keep
+// the name of the file, those with several get the name of the sample too.
+std::string output_name(const std::string& f, const std::string& sample,
+	bool compress)
+{
+	std::string name=sample.empty()?f:f+"."+sample;
+	return name+(compress?".nf.gz":".nf");
+}
+
+// Loads and normalizes every file, blurs the files that are in flight
+// together, and hands the results on to the computation of the profiles and
+// to the spill in the order of the files. Profiles that are not computed
+// have neither a sketch nor a vector. With split_samples, a file that holds
+// several samples is read in one pass and each of its samples is treated
+// like a file of its own. The names of the samples of every file are stored
+// in samples, a single empty one for files that hold only one sample.
+class ReadStage : public FileStage
+{
+public:
+
+	ReadStage(const std::vector<std::string>& f, Cnv::StringPool& p,
+		std::vector<std::vector<std::string> >& s)
+		:samples(s),filenames(f),pool(p),whole(f.size()),low(f.size()),
+		baf(f.size()),x_chr(f.size())
+		{ samples.assign(f.size(), std::vector<std::string>()); }
+
+	void process(unsigned i, std::ostream& out)
+	{
+		if(verbose) out<<"  file \'"<<filenames[i]<<"\' ...";
+
+		std::vector<Cnv::Sequence> columns;
+		if(split_samples)
+			columns=PennCnv::load_samples(filenames[i], pool, samples[i]);
+		if(samples[i].size()<=1)
+		{
+			samples[i].assign(1, std::string());
+			if(columns.empty()) columns=use_cache?
+				Cnv::load_cached(filenames[i], pool, PennCnv::load, 2):
+				PennCnv::load(filenames[i], pool);
+			columns.resize(2);
+		}
+
+		unsigned n=samples[i].size();
+		whole[i].resize(n);
+		baf[i].resize(n);
+		x_chr[i].assign(n, 0.0);
+		for(unsigned k=0; k<n; k++)
+		{
+			if( !use_sex_chromosomes ) columns[2*k]=Cnv::stripXY(columns[2*k]);
+			whole[i][k]=normalize_sequence(columns[2*k], x_chr[i][k]);
+			std::swap(baf[i][k], columns[2*k+1]);
+			columns[2*k]=Cnv::Sequence();
+		}
+
+		if(verbose&&n>1) out<<" "<<n<<" samples";
+		if(verbose) out<<" done"<<std::endl;
+	}
+
+	// Segments of the same length in all files are transformed by one plan.
+	void finish(unsigned first, unsigned last)
+	{
+		std::vector<const Cnv::Sequence*> batch;
+		for(unsigned i=first; i<last; i++)
+			for(unsigned k=0; k<whole[i].size(); k++)
+				batch.push_back(&whole[i][k]);
+		std::vector<Cnv::Sequence> blurred=
+			Cnv::blur(batch, 1000.0, blur_engine, blur_scope);
+
+		unsigned b=0;
+		for(unsigned i=first; i<last; i++)
+		{
+			low[i].resize(whole[i].size());
+			for(unsigned k=0; k<whole[i].size(); k++)
+				std::swap(low[i][k], blurred[b++]);
+			finish(i);
+		}
+	}
+
+	void finish(unsigned i)
+	{
+		for(unsigned k=0; k<whole[i].size(); k++)
+		{
+			Cnv::Sequence high_seq = whole[i][k]-low[i][k];
+
+			if(low_sketch) low_sketch->add(low[i][k]);
+			else if(low_seq_vec) low_seq_vec->push_back(low[i][k]);
+			if(high_sketch) high_sketch->add(high_seq);
+			else if(high_seq_vec) high_seq_vec->push_back(high_seq);
+
+			if(spill) spill->put(whole[i][k], low[i][k], baf[i][k], x_chr[i][k]);
+		}
+
+		whole[i].clear();
+		low[i].clear();
+		baf[i].clear();
+	}
+
+	bool verbose;
+	bool use_sex_chromosomes;
+	bool use_cache;
+	bool split_samples;
+	Cnv::BlurEngine blur_engine;
+	Cnv::BlurScope blur_scope;
+	Cnv::MedianSketch* low_sketch;
+	Cnv::MedianSketch* high_sketch;
+	std::vector<Cnv::Sequence>* low_seq_vec;
+	std::vector<Cnv::Sequence>* high_seq_vec;
+	Spill* spill;
+	std::vector<std::vector<std::string> >& samples;
+
+private:
+
+	const std::vector<std::string>& filenames;
+	Cnv::StringPool& pool;
+	std::vector<std::vector<Cnv::Sequence> > whole, low, baf;
+	std::vector<std::vector<double> > x_chr;
+};
+
+// Removes the profiles from every sample of every file and saves the result.
+// The data is read back from the spill in the order of the files.
+class ApplyStage : public FileStage
+{
+public:
+
+	ApplyStage(const std::vector<std::string>& f,
+		const std::vector<std::vector<std::string> >& n, Spill& s,
+		const Cnv::Sequence& l, const Cnv::Sequence& h)
+		:filenames(f),samples(n),spill(s),low_profile(l),high_profile(h),
+		low_prof_var(Cnv::mean_square(l)),high_prof_var(Cnv::mean_square(h)),
+		whole(f.size()),low(f.size()),baf(f.size()),x_chr(f.size())
+		{}
+
+	void prepare(unsigned i)
+	{
+		unsigned n=samples[i].size();
+		whole[i].resize(n);
+		low[i].resize(n);
+		baf[i].resize(n);
+		x_chr[i].assign(n, 0.0);
+		for(unsigned k=0; k<n; k++)
+			spill.get(whole[i][k], low[i][k], baf[i][k], x_chr[i][k]);
+	}
+
+	void process(unsigned i, std::ostream& out)
+	{
+		for(unsigned k=0; k<samples[i].size(); k++) apply(i, k, out);
+		whole[i].clear();
+		low[i].clear();
+		baf[i].clear();
+	}
+
+	bool verbose;
+	bool compress_output;
+
+private:
+
+	void apply(unsigned i, unsigned k, std::ostream& out)
+	{
+		std::string name=output_name(filenames[i], samples[i][k],
+			compress_output);
+		if(verbose) out<<(samples[i][k].empty()?filenames[i]:
+			filenames[i]+"."+samples[i][k])<<"\t";
+
+		std::vector<Cnv::Sequence> pair(2);
+		Cnv::Sequence whole_seq;
+		Cnv::Sequence low_seq;
+		std::swap(whole_seq, whole[i][k]);
+		std::swap(low_seq, low[i][k]);
+		std::swap(pair[1], baf[i][k]);
+		Cnv::Sequence high_seq  = whole_seq-low_seq;
+
+		double whole_var = Cnv::mean_square(whole_seq);
+		double low_var   = Cnv::mean_square(low_seq);
+		double high_var  = Cnv::mean_square(high_seq);
+
+		Cnv::AlignmentPlan low_plan, high_plan;
+		double low_covar   = Cnv::mean_product(low_seq, low_profile, low_plan);
+		double high_covar  = Cnv::mean_product(high_seq, high_profile, high_plan);
+
+		double low_correl   = low_covar / ::sqrt( low_var*low_prof_var );
+		double high_correl  = high_covar / ::sqrt( high_var*high_prof_var );
+
+		double low_factor   = low_covar / low_prof_var;
+		double high_factor  = high_covar / high_prof_var;
+
+		low_seq  = (Cnv::lazy(low_seq)-Cnv::lazy(low_profile) * (float)low_factor).evaluate(low_plan);
+		high_seq = (Cnv::lazy(high_seq)-Cnv::lazy(high_profile) * (float)high_factor).evaluate(high_plan);
+		pair[0]  = unnormalize_x_chromo(low_seq+high_seq, x_chr[i][k]);
+
+		if(verbose) out
+			<<whole_var<<"\t"
+			<<low_var<<"\t"
+			<<high_var<<"\t"
+			<<low_prof_var<<"\t"
+			<<high_prof_var<<"\t"
+			<<low_covar<<"\t"
+			<<high_covar<<"\t"
+			<<low_correl<<"\t"
+			<<high_correl<<"\t"
+			<<low_factor<<"\t"
+			<<high_factor;
+
+		PennCnv::save(pair, name);
+
+		if(verbose) out<<std::endl;
+	}
+
+	const std::vector<std::string>& filenames;
+	const std::vector<std::vector<std::string> >& samples;
+	Spill& spill;
+	const Cnv::Sequence& low_profile;
+	const Cnv::Sequence& high_profile;
+	double low_prof_var;
+	double high_prof_var;
+	std::vector<std::vector<Cnv::Sequence> > whole, low, baf;
+	std::vector<std::vector<double> > x_chr;
+};
+
 int main(int Args, char** Arg)
 {
 	bool verbose = false;
 	bool only_profiles = false;
 	bool use_sex_chromosomes = false;
+	bool use_cache = false;
+	bool split_samples = false;
+	bool compress_output = false;
+	Cnv::BlurEngine blur_engine = Cnv::FourierBlur;
+	Cnv::BlurScope blur_scope = Cnv::GenomeScope;
+	unsigned median_sketch = 0;
+	unsigned jobs = 1;
+	unsigned long long memory_budget = 0;
 	std::string  low_profile_file;
 	std::string  high_profile_file;
 	std::vector<std::string> filenames;
@@ -117,6 +568,26 @@ int main(int Args, char** Arg)
 			"      --per-snp-profile [FILE]  use precomputed per-SNP profile\n"
 			"      --use-sex-chromosomes     do not discard sex chromosomes\n"
 			"      --only-profiles           do not apply the profiles\n"
+			"      --cache                   keep a binary copy of every file next to it\n"
+			"                                  and load that copy while it is up to date\n"
+			"      --samples                 filter every sample of files that hold\n"
+			"                                  several, and save them as FILE.SAMPLE.nf\n"
+			"      --compress-output         write the filtered files gzip compressed,\n"
+			"                                  as FILE.nf.gz\n"
+			"      --fftw-wisdom [FILE]      load and store tuned FFT plans in FILE\n"
+			"      --blur-engine [ENGINE]    blur with \'fft\' (default) or with the faster\n"
+			"                                  \'recursive\' gaussian approximation\n"
+			"      --blur-chromosomes        blur each chromosome on its own\n"
+			"      --median-sketch [SIZE]    compute the profiles from fewer than 3*SIZE\n"
+			"                                  values per probe instead of keeping all\n"
+			"                                  files in memory, exact up to SIZE files\n"
+			"  -j, --jobs [N]                process up to N files at once, one by\n"
+			"                                  default; each file uses all processors\n"
+			"                                  as well, so N only pays for small files\n"
+			"      --memory-budget [MB]      start no further files while the files in\n"
+			"                                  progress are larger than MB megabytes\n"
+			"\n"
+			"Input files may be compressed with gzip or bgzip.\n"
 			"\n"
 			"Report noise-free-cnv bugs to philip.development@googlemail.com\n"
 			"noise-free-cnv home page: <http://noise-free-cnv.sourceforge.net>"<<std::endl;
@@ -136,6 +607,26 @@ int main(int Args, char** Arg)
 			"      --per-snp-profile [FILE]  use precomputed per-SNP profile\n"
 			"      --use-sex-chromosomes     do not discard sex chromosomes\n"
 			"      --only-profiles           do not apply the profiles\n"
+			"      --cache                   keep a binary copy of every file next to it\n"
+			"                                  and load that copy while it is up to date\n"
+			"      --samples                 filter every sample of files that hold\n"
+			"                                  several, and save them as FILE.SAMPLE.nf\n"
+			"      --compress-output         write the filtered files gzip compressed,\n"
+			"                                  as FILE.nf.gz\n"
+			"      --fftw-wisdom [FILE]      load and store tuned FFT plans in FILE\n"
+			"      --blur-engine [ENGINE]    blur with \'fft\' (default) or with the faster\n"
+			"                                  \'recursive\' gaussian approximation\n"
+			"      --blur-chromosomes        blur each chromosome on its own\n"
+			"      --median-sketch [SIZE]    compute the profiles from fewer than 3*SIZE\n"
+			"                                  values per probe instead of keeping all\n"
+			"                                  files in memory, exact up to SIZE files\n"
+			"  -j, --jobs [N]                process up to N files at once, one by\n"
+			"                                  default; each file uses all processors\n"
+			"                                  as well, so N only pays for small files\n"
+			"      --memory-budget [MB]      start no further files while the files in\n"
+			"                                  progress are larger than MB megabytes\n"
+			"\n"
+			"Input files may be compressed with gzip or bgzip.\n"
 			"\n"
 				"Report noise-free-cnv bugs to philip.development@googlemail.com\n"
 				"noise-free-cnv home page: <http://noise-free-cnv.sourceforge.net>"<<std::endl;
@@ -167,6 +658,64 @@ int main(int Args, char** Arg)
 				high_profile_file = std::string(Arg[i]);
 			}
 		}
+		else if(!strcmp(Arg[i], "--fftw-wisdom"))
+		{
+			if(++i<Args)
+			{
+				Cnv::Fourier::use_wisdom(Arg[i]);
+			}
+		}
+		else if(!strcmp(Arg[i], "--blur-engine"))
+		{
+			if(++i<Args)
+			{
+				if(!strcmp(Arg[i], "fft")) blur_engine=Cnv::FourierBlur;
+				else if(!strcmp(Arg[i], "recursive")) blur_engine=Cnv::RecursiveBlur;
+				else
+				{
+					std::cout<<"noise-free-cnv-filter: invalid blur engine \'"<<Arg[i]<<"\'\n"
+						"Try \'noise-free-cnv-filter --help\' for more information."<<std::endl;
+					return 0;
+				}
+			}
+		}
+		else if(!strcmp(Arg[i], "--blur-chromosomes"))
+		{
+			blur_scope=Cnv::ChromosomeScope;
+		}
+		else if(!strcmp(Arg[i], "--median-sketch"))
+		{
+			if(++i<Args)
+			{
+				median_sketch = atoi(Arg[i]);
+			}
+		}
+		else if(!strcmp(Arg[i], "-j")||!strcmp(Arg[i], "--jobs"))
+		{
+			if(++i<Args)
+			{
+				jobs = std::max(1, atoi(Arg[i]));
+			}
+		}
+		else if(!strcmp(Arg[i], "--memory-budget"))
+		{
+			if(++i<Args)
+			{
+				memory_budget = strtoull(Arg[i], NULL, 10)<<20;
+			}
+		}
+		else if(!strcmp(Arg[i], "--cache"))
+		{
+			use_cache = true;
+		}
+		else if(!strcmp(Arg[i], "--samples"))
+		{
+			split_samples = true;
+		}
+		else if(!strcmp(Arg[i], "--compress-output"))
+		{
+			compress_output = true;
+		}
 		else if(!strcmp(Arg[i], "--only-profiles"))
 		{
 			only_profiles = true;
@@ -191,108 +740,126 @@ int main(int Args, char** Arg)
 		}
 	}
 
-	if(verbose) std::cout<<"used flags: "<<(verbose?"verbose ":"")<<(only_profiles?"only-profiles":"")<<(use_sex_chromosomes?"use_sex_chromosomes":"")<<std::endl;
+	if(verbose)
+	{
+		std::cout<<"used flags: "<<(verbose?"verbose ":"")<<(only_profiles?"only-profiles ":"")<<(use_sex_chromosomes?"use_sex_chromosomes ":"")
+			<<(use_cache?"cache ":"")<<(split_samples?"samples ":"")
+			<<(compress_output?"compress-output ":"")
+			<<"blur-engine="<<((blur_engine==Cnv::RecursiveBlur)?"recursive ":"fft ")
+			<<((blur_scope==Cnv::ChromosomeScope)?"blur-chromosomes ":"")
+			<<"jobs="<<jobs<<" ";
+		if(median_sketch>0) std::cout<<"median-sketch="<<median_sketch<<" ";
+		if(memory_budget>0) std::cout<<"memory-budget="<<(memory_budget>>20)<<" ";
+		std::cout<<std::endl;
+	}
 
 	Cnv::StringPool string_pool;
 	std::vector<const Cnv::Sequence*> temp_vector;
 
 	Cnv::Sequence low_profile;
-	
-	if(low_profile_file.empty())
-	{
-		if(verbose) std::cout<<"computing wave profile: "<<std::endl;
-
-		std::vector<Cnv::Sequence> low_seq_vec;
-		low_seq_vec.reserve(Args-1);
-		for(unsigned i=0; i<filenames.size(); i++)
-		{
-			if(verbose) std::cout<<"  file \'"<<filenames[i]<<"\' ...";
-			if(verbose) std::cout.flush();
-
-			std::vector<Cnv::Sequence> pair=
-				PennCnv::load(filenames[i], string_pool);
-
-			double X_chr_intens=0.0;
-			if( !use_sex_chromosomes ) pair[0]=Cnv::stripXY(pair[0]);
-			pair[0]=normalize_sequence(pair[0], X_chr_intens);
-			pair[0]=Cnv::blur(pair[0], 1000.0);
-
-			low_seq_vec.push_back(pair[0]);
-
-			if(verbose) std::cout<<" done"<<std::endl;
-		}
-
-		if(verbose) std::cout<<"  computing median sequence ...";
-		if(verbose) std::cout.flush();
-
-		temp_vector.resize(low_seq_vec.size());
-		for(unsigned k=0; k<low_seq_vec.size(); k++)
-			temp_vector[k]=&(low_seq_vec[k]);
-		low_profile=Cnv::median(temp_vector);
+	Cnv::Sequence high_profile;
+	bool compute_low  = low_profile_file.empty();
+	bool compute_high = high_profile_file.empty();
 
-		if(verbose) std::cout<<"saving as \"wave_profile\": "<<std::endl;
+	if(!compute_low)
+	{
+		if(verbose) std::cout<<"loading wave profile: "<<std::endl;
 
-		Cnv::save(low_profile, "wave_profile");
+		low_profile = Cnv::load( low_profile_file, string_pool );
 
 		if(verbose) std::cout<<" done!"<<std::endl;
 	}
-	else
+
+	if(!compute_high)
 	{
-		if(verbose) std::cout<<"loading wave profile: "<<std::endl;
+		if(verbose) std::cout<<"loading per-SNP profile: "<<std::endl;
 
-		low_profile = Cnv::load( low_profile_file, string_pool );
+		high_profile = Cnv::load( high_profile_file, string_pool );
 
 		if(verbose) std::cout<<" done!"<<std::endl;
 	}
 
+	// every file is parsed, normalized and blurred only once, several files
+	// at a time on the pool
+	std::vector<Cnv::Sequence> low_seq_vec;
+	std::vector<Cnv::Sequence> high_seq_vec;
+	Cnv::MedianSketch low_sketch(median_sketch);
+	Cnv::MedianSketch high_sketch(median_sketch);
+	Spill spill;
+	std::vector<std::vector<std::string> > samples;
+
+	FilePool pool(jobs, memory_budget);
+	// The memory a file needs while it is processed is estimated by the size
+	// of its contents, which for compressed files is several times the size
+	// of the file.
+	std::vector<unsigned long long> costs;
+	for(unsigned i=0; i<filenames.size(); i++)
+		costs.push_back(Cnv::contents_size(filenames[i]));
+
+	if(compute_low||compute_high||!only_profiles)
+	{
+		if(verbose) std::cout<<"reading files: "<<std::endl;
+
+		ReadStage stage(filenames, string_pool, samples);
+		stage.verbose = verbose;
+		stage.use_sex_chromosomes = use_sex_chromosomes;
+		stage.use_cache = use_cache;
+		stage.split_samples = split_samples;
+		stage.blur_engine = blur_engine;
+		stage.blur_scope = blur_scope;
+		stage.low_sketch   = (compute_low&&median_sketch>0)?&low_sketch:NULL;
+		stage.high_sketch  = (compute_high&&median_sketch>0)?&high_sketch:NULL;
+		stage.low_seq_vec  = (compute_low&&median_sketch==0)?&low_seq_vec:NULL;
+		stage.high_seq_vec = (compute_high&&median_sketch==0)?&high_seq_vec:NULL;
+		stage.spill = only_profiles?NULL:&spill;
+		pool.run(stage, costs);
+	}
 
-	Cnv::Sequence high_profile;
-	if(high_profile_file.empty())
+	if(compute_low)
 	{
-		if(verbose) std::cout<<"computing per-SNP profile: "<<std::endl;
+		if(verbose) std::cout<<"computing wave profile ...";
+		if(verbose) std::cout.flush();
 
-		std::vector<Cnv::Sequence> high_seq_vec;
-		high_seq_vec.reserve(Args-1);
-		for(unsigned i=0; i<filenames.size(); i++)
+		if(median_sketch>0) low_profile=low_sketch.median();
+		else
 		{
-			if(verbose) std::cout<<"  file \'"<<filenames[i]<<"\' ...";
-			if(verbose) std::cout.flush();
-
-			std::vector<Cnv::Sequence> pair=
-				PennCnv::load(filenames[i], string_pool);
+			temp_vector.resize(low_seq_vec.size());
+			for(unsigned k=0; k<low_seq_vec.size(); k++)
+				temp_vector[k]=&(low_seq_vec[k]);
+			low_profile=Cnv::median(temp_vector);
+			low_seq_vec.clear();
+		}
 
-			double X_chr_intens=0.0;
-			if( !use_sex_chromosomes ) pair[0]=Cnv::stripXY(pair[0]);
-			pair[0]=normalize_sequence(pair[0], X_chr_intens);
-			pair[0]=pair[0]-Cnv::blur(pair[0], 1000.0);
+		if(verbose) std::cout<<" done"<<std::endl;
+		if(verbose) std::cout<<"saving as \"wave_profile\": "<<std::endl;
 
-			high_seq_vec.push_back(pair[0]);
+		Cnv::save(low_profile, "wave_profile");
 
-			if(verbose) std::cout<<" done"<<std::endl;
-		}
+		if(verbose) std::cout<<" done!"<<std::endl;
+	}
 
-		if(verbose) std::cout<<"  computing median sequence ...";
+	if(compute_high)
+	{
+		if(verbose) std::cout<<"computing per-SNP profile ...";
 		if(verbose) std::cout.flush();
 
-		temp_vector.resize(high_seq_vec.size());
-		for(unsigned k=0; k<high_seq_vec.size(); k++)
-			temp_vector[k]=&(high_seq_vec[k]);
-		high_profile=Cnv::median(temp_vector);
+		if(median_sketch>0) high_profile=high_sketch.median();
+		else
+		{
+			temp_vector.resize(high_seq_vec.size());
+			for(unsigned k=0; k<high_seq_vec.size(); k++)
+				temp_vector[k]=&(high_seq_vec[k]);
+			high_profile=Cnv::median(temp_vector);
+			high_seq_vec.clear();
+		}
 
+		if(verbose) std::cout<<" done"<<std::endl;
 		if(verbose) std::cout<<"saving as \"per-snp_profile\": "<<std::endl;
 
 		Cnv::save(high_profile, "per-snp_profile");
 
 		if(verbose) std::cout<<" done!"<<std::endl;
 	}
-	else
-	{
-		if(verbose) std::cout<<"loading per-SNP profile: "<<std::endl;
-
-		high_profile = Cnv::load( high_profile_file, string_pool );
-
-		if(verbose) std::cout<<" done!"<<std::endl;
-	}
 
 
 	if(!only_profiles)
@@ -301,60 +868,32 @@ int main(int Args, char** Arg)
 		if(verbose) std::cout<<"filename\tvariance\twave variance\tper-SNP variance\twave profile variance\tper-SNP profile variance\t"
 			"wave covariance\tper-SNP covariance\twave correlation\tper-SNP correlation\twave subtraction factor\tper-SNP subtraction factor"<<std::endl;
 
-		for(unsigned i=0; i<filenames.size(); i++)
-		{
-			if(verbose) std::cout<<filenames[i]<<"\t";
-			if(verbose) std::cout.flush();
-
-			std::vector<Cnv::Sequence> pair=
-				PennCnv::load(filenames[i], string_pool);
-
-			double X_chr_intens=0.0;
-			if( !use_sex_chromosomes ) pair[0]=Cnv::stripXY(pair[0]);
-
-			Cnv::Sequence whole_seq = normalize_sequence(pair[0], X_chr_intens);
-			Cnv::Sequence low_seq   = Cnv::blur(whole_seq, 1000.0);
-			Cnv::Sequence high_seq  = whole_seq-low_seq;
+		ApplyStage stage(filenames, samples, spill, low_profile, high_profile);
+		stage.verbose = verbose;
+		stage.compress_output = compress_output;
+		pool.run(stage, costs);
 
-			Cnv::Sequence whole_var = Cnv::avg(whole_seq*whole_seq);
-			Cnv::Sequence low_var   = Cnv::avg(low_seq*low_seq);
-			Cnv::Sequence high_var  = Cnv::avg(high_seq*high_seq);
-
-			Cnv::Sequence low_prof_var   = Cnv::avg(low_profile*low_profile);
-			Cnv::Sequence high_prof_var  = Cnv::avg(high_profile*high_profile);
-
-			Cnv::Sequence low_covar   = Cnv::avg(low_seq*low_profile);
-			Cnv::Sequence high_covar  = Cnv::avg(high_seq*high_profile);
-
-			Cnv::Sequence low_correl   = low_covar / Cnv::pow( low_var*low_prof_var, 0.5 );
-			Cnv::Sequence high_correl  = high_covar / Cnv::pow( high_var*high_prof_var, 0.5 );
-
-			Cnv::Sequence low_factor   = low_covar / low_prof_var;
-			Cnv::Sequence high_factor  = high_covar / high_prof_var;
-
-			low_seq  = low_seq-low_profile * low_covar / low_prof_var;
-			high_seq = high_seq-high_profile * high_covar / high_prof_var;
-			pair[0]  = unnormalize_x_chromo(low_seq+high_seq, X_chr_intens);
-
-			if(verbose) std::cout
-				<<whole_var.get_values()[0]<<"\t"
-				<<low_var.get_values()[0]<<"\t"
-				<<high_var.get_values()[0]<<"\t"
-				<<low_prof_var.get_values()[0]<<"\t"
-				<<high_prof_var.get_values()[0]<<"\t"
-				<<low_covar.get_values()[0]<<"\t"
-				<<high_covar.get_values()[0]<<"\t"
-				<<low_correl.get_values()[0]<<"\t"
-				<<high_correl.get_values()[0]<<"\t"
-				<<low_factor.get_values()[0]<<"\t"
-				<<high_factor.get_values()[0];
-
-			PennCnv::save(pair, filenames[i]+".nf");
+		if(verbose) std::cout<<"done!"<<std::endl;
+	}
 
-			if(verbose) std::cout<<std::endl;
-		}
+	Cnv::Fourier::save_wisdom();
 
-		if(verbose) std::cout<<"done!"<<std::endl;
+	if(verbose)
+	{
+		Cnv::StringPool::Stats stats=string_pool.stats();
+		std::cout<<"string pool: "<<stats.strings<<" names, "
+			<<stats.string_bytes<<" bytes of text, "
+			<<stats.arena_bytes+stats.table_bytes<<" bytes allocated"<<std::endl;
+
+		Cnv::LoadStats load=Cnv::load_stats();
+		const char* stages[]={"read", "inflate", "parse"};
+		std::cout<<"loading:"<<std::endl;
+		for(unsigned s=0; s<Cnv::LoadStats::stages; ++s)
+			if(load.bytes[s]>0)
+				std::cout<<"  "<<stages[s]<<" time: "<<load.seconds[s]<<" s for "
+					<<load.bytes[s]<<" bytes ("
+					<<load.bytes[s]/std::max(load.seconds[s], 1e-9)/(1<<20)
+					<<" MB/s)"<<std::endl;
 	}
 
 	return 0;